@@ -0,0 +1,57 @@
+#include "zrtc/event_loop/awaitable.h"
+
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/loop_stats.h"
+
+namespace evloop {
+
+SleepAwaitable::SleepAwaitable(EventLoop *loop, int delay_ms)
+	: loop_(loop)
+	, delay_ms_(delay_ms)
+	, scheduled_(false) {
+}
+
+SleepAwaitable::SleepAwaitable(SleepAwaitable &&other)
+	: loop_(other.loop_)
+	, delay_ms_(other.delay_ms_)
+	, scheduled_(false) {
+	assert(!other.scheduled_);
+}
+
+SleepAwaitable::~SleepAwaitable() {
+	// The coroutine was destroyed while sleeping
+	if (scheduled_) {
+		EventDel(&event_);
+	}
+}
+
+void SleepAwaitable::Schedule() {
+	assert(loop_->IsInLoopThread());
+
+	struct timeval tv;
+	tv.tv_sec = delay_ms_ / 1000;
+	tv.tv_usec = (delay_ms_ % 1000) * 1000;
+
+	event_set(&event_, -1, 0, &SleepAwaitable::HandlerFn, this);
+	event_base_set(loop_->event_base(), &event_);
+
+	if (EventAdd(&event_, &tv) != 0) {
+		LOG_T_F(LS_ERROR) << "event_add failed, resume now.";
+		resumer_();
+		return;
+	}
+
+	scheduled_ = true;
+}
+
+void SleepAwaitable::HandlerFn(int fd, short which, void *v) {
+	SleepAwaitable *s = (SleepAwaitable *)v;
+	CallbackStatsScope scope(s->loop_->stats_collector(),
+							LoopStatsCollector::kTimerCallback,
+							reinterpret_cast<intptr_t>(s));
+	s->scheduled_ = false;
+	s->resumer_();
+}
+
+} // namespace evloop
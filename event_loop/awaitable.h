@@ -0,0 +1,143 @@
+/*
+ * File:   awaitable.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 5:10 PM
+ */
+
+#ifndef ZRTC_AWAITABLE_H
+#define ZRTC_AWAITABLE_H
+
+#include <cassert>
+
+#include "zrtc/event_loop/libevent.h"
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#define ZRTC_EVLOOP_HAS_COROUTINE 1
+#endif
+
+// Awaitables for C++20 coroutines, next to the callback API:
+//
+//   co_await loop->Sleep(100);
+//   Connector::ConnectResult r = co_await connector->Connect(addr, 3000);
+//   TcpConn::Frame f = co_await conn->ReadFrame();
+//   co_await conn->Drain();
+//
+// The coroutine must run in the io event thread and is resumed straight
+// from the libevent callback, without going through the functor queue.
+// Each awaitable keeps its state in itself, i.e. in the coroutine frame,
+// so an await does not allocate. The types only need C++11, a C++11
+// translation unit can include them but not co_await them.
+
+namespace evloop {
+
+class EventLoop;
+
+// @brief: A type-erased coroutine handle
+class CoroutineResumer {
+public:
+	CoroutineResumer(): address_(nullptr), resume_(nullptr) {}
+
+	template <typename Handle>
+	void Set(Handle h) {
+		address_ = h.address();
+		resume_ = &CoroutineResumer::Resume<Handle>;
+	}
+
+	bool empty() const {
+		return address_ == nullptr;
+	}
+
+	// @brief: Resume the coroutine, at most once per Set()
+	void operator()() {
+		assert(address_);
+		void *address = address_;
+		address_ = nullptr;
+		resume_(address);
+	}
+
+private:
+	template <typename Handle>
+	static void Resume(void *address) {
+		Handle::from_address(address).resume();
+	}
+
+	void *address_;
+	void (*resume_)(void *address);
+};
+
+// @brief: Returned by EventLoop::Sleep
+class SleepAwaitable {
+public:
+	SleepAwaitable(EventLoop *loop, int delay_ms);
+
+	// @note: Only before it is awaited
+	SleepAwaitable(SleepAwaitable &&other);
+
+	~SleepAwaitable();
+
+	bool await_ready() const {
+		return delay_ms_ <= 0;
+	}
+
+	template <typename Handle>
+	void await_suspend(Handle h) {
+		resumer_.Set(h);
+		Schedule();
+	}
+
+	void await_resume() {}
+
+private:
+	SleepAwaitable(const SleepAwaitable &);
+	SleepAwaitable &operator=(const SleepAwaitable &);
+
+	void Schedule();
+
+	static void HandlerFn(int fd, short which, void *v);
+
+private:
+	EventLoop *loop_;
+	int delay_ms_;
+	bool scheduled_;
+	struct event event_;
+	CoroutineResumer resumer_;
+};
+
+#ifdef ZRTC_EVLOOP_HAS_COROUTINE
+// @brief: Return type of a coroutine started from the io event thread and
+// left to run on its own, e.g.
+//
+//   evloop::LoopCoroutine Session(evloop::EventLoop *loop) { ... }
+//   loop->RunInLoop([loop] { Session(loop); });
+//
+// The frame is freed when the coroutine returns. An escaping exception
+// terminates the program, as it would in a callback.
+struct LoopCoroutine {
+	struct promise_type {
+		LoopCoroutine get_return_object() {
+			return LoopCoroutine();
+		}
+
+		std::suspend_never initial_suspend() noexcept {
+			return std::suspend_never();
+		}
+
+		std::suspend_never final_suspend() noexcept {
+			return std::suspend_never();
+		}
+
+		void return_void() {}
+
+		void unhandled_exception() {
+			std::terminate();
+		}
+	};
+};
+#endif // ZRTC_EVLOOP_HAS_COROUTINE
+
+} // namespace evloop
+
+#endif /* ZRTC_AWAITABLE_H */
@@ -4,7 +4,6 @@
 
 #include "zrtc/event_loop/event_common.h"
 #include "zrtc/event_loop/event_loop.h"
-#include "zrtc/event_loop/event_watcher.h"
 #include "zrtc/event_loop/dns_resolver.h"
 #include "zrtc/event_loop/fd_channel.h"
 #include "zrtc/event_loop/event_sockets.h"
@@ -24,7 +23,12 @@ Connector::Connector(EventLoop * loop,
 	, remote_address_(remote_addr)
 	, connecting_timeout_ms_(timeout_ms)
 	, auto_reconnect_(auto_reconnect)
-	, reconnect_interval_ms_(interval_ms) {
+	, reconnect_interval_ms_(interval_ms)
+	, fd_(-1)
+	, own_fd_(false)
+	, timer_(loop, std::bind(&Connector::OnConnectTimeout, this))
+	, awaiting_(nullptr) {
+	memset(&raddr_, 0, sizeof(raddr_));
 	if (sock::SplitHostPort(remote_address_.data(), remote_host_, remote_port_)) {
 		raddr_ = sock::ParseFromIPPort(remote_address_.data());
 	}
@@ -49,11 +53,8 @@ void Connector::Start() {
 	assert(loop_->IsInLoopThread());
 	LOG_T_F(LS_INFO) << "CUONGCB::Start tcp connector";
 	
-	timer_.reset(new TimerEventWatcher(loop_,
-				std::bind(&Connector::OnConnectTimeout, shared_from_this()),
-				connecting_timeout_ms_));
-	timer_->Init();
-	timer_->AsyncWait();
+	// The channel and DNS callbacks hold us while the timer is pending
+	timer_.Start(connecting_timeout_ms_);
 	
 	if (!sock::IsZeroAddress(&raddr_)) {
 		Connect();
@@ -70,6 +71,44 @@ void Connector::Start() {
 	dns_resolver_->Start();
 }
 
+Connector::ConnectAwaitable Connector::Connect(const std::string &remote_addr,
+												int timeout_ms) {
+	remote_address_ = remote_addr;
+	connecting_timeout_ms_ = timeout_ms;
+	
+	memset(&raddr_, 0, sizeof(raddr_));
+	if (sock::SplitHostPort(remote_address_.data(), remote_host_, remote_port_)) {
+		raddr_ = sock::ParseFromIPPort(remote_address_.data());
+	}
+	
+	return ConnectAwaitable(this);
+}
+
+void Connector::StartAwait(ConnectAwaitable *awaitable) {
+	awaiting_ = awaitable;
+	conn_fn_ = std::bind(&Connector::ResumeAwaiting, this,
+						std::placeholders::_1, std::placeholders::_2);
+	Start();
+}
+
+void Connector::ResumeAwaiting(int fd, const std::string &local_addr) {
+	if (awaiting_ == nullptr) {
+		// An auto reconnect succeeded after the coroutine got its failure
+		if (fd >= 0) {
+			EVUTIL_CLOSESOCKET(fd);
+		}
+		
+		return;
+	}
+	
+	// Resume right here, in HandleWrite/HandleError on the io event thread
+	ConnectAwaitable *awaitable = awaiting_;
+	awaiting_ = nullptr;
+	awaitable->result_.fd = fd;
+	awaitable->result_.local_addr = local_addr;
+	awaitable->resumer_();
+}
+
 void Connector::Cancel() {
 	assert(loop_->IsInLoopThread());
 	LOG_T_F(LS_INFO) << "CUONGCB::Cancel tcp connector";
@@ -79,9 +118,7 @@ void Connector::Cancel() {
 		dns_resolver_.reset();
 	}
 	
-	assert(timer_);
-	timer_->Cancel();
-	timer_.reset();
+	timer_.Cancel();
 	
 	if (status_ == kDNSResolving) {
 		conn_fn_(-1, "");
@@ -159,8 +196,7 @@ void Connector::HandleWrite() {
 	own_fd_ = false; // Move the ownership of the fd to TCPConn
 	fd_ = -1;
 	status_ = kConnected;
-	timer_->Cancel();
-	timer_.reset();
+	timer_.Cancel();
 	chan_->DisableAllEvent();
 	chan_->Close(); // If the application did reset the connector, closing chan_
 					// is the ending point of this object by releasing chan_
@@ -195,8 +231,7 @@ void Connector::HandleError() {
         dns_resolver_.reset();
     }
 
-    timer_->Cancel();
-    timer_.reset();
+    timer_.Cancel();
 
     // If the connection is refused or it will not try again,
     // We need to notify the user layer that the connection established failed.
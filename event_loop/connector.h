@@ -9,19 +9,22 @@
 #define ZRTC_TCPCONNECTOR_H
 
 #include <memory>
+#include <string>
 
+#include "zrtc/event_loop/awaitable.h"
 #include "zrtc/event_loop/event_common.h"
 #include "zrtc/event_loop/event_sockets.h"
+#include "zrtc/event_loop/loop_allocator.h"
+#include "zrtc/event_loop/timer.h"
 
 namespace evloop {
 
 class FdChannel;
 class EventLoop;
-class EventWatcher;
 class DNSResolver;
 
 
-class Connector:
+class Connector: public LoopAllocated,
 public std::enable_shared_from_this<Connector> {
 public:
 	typedef std::function<void(int, const std::string &)> NewConnectionCallback;
@@ -38,6 +41,46 @@ public:
 	void Start();
 	void Cancel();
 	
+public:
+	struct ConnectResult {
+		ConnectResult(): fd(-1) {}
+		
+		int fd; // -1 if the connection failed
+		std::string local_addr;
+	};
+	
+	class ConnectAwaitable {
+	public:
+		explicit ConnectAwaitable(Connector *c): connector_(c) {}
+		
+		bool await_ready() const {
+			return false;
+		}
+		
+		template <typename Handle>
+		void await_suspend(Handle h) {
+			resumer_.Set(h);
+			connector_->StartAwait(this);
+		}
+		
+		ConnectResult await_resume() {
+			return std::move(result_);
+		}
+		
+	private:
+		friend class Connector;
+		
+		Connector *connector_;
+		ConnectResult result_;
+		CoroutineResumer resumer_;
+	};
+	
+	// @brief: co_await connector->Connect(addr, timeout_ms) connects to
+	// remote_addr ("host:port") and resumes with the new fd, or -1 if it
+	// failed. It takes the place of the NewConnectionCallback
+	// @note: It must be awaited in the io event thread
+	ConnectAwaitable Connect(const std::string &remote_addr, int timeout_ms);
+	
 public:
 	void SetNewConnectionCallback(NewConnectionCallback cb) {
 		conn_fn_ = cb;
@@ -61,6 +104,8 @@ public:
 	
 private:
 	void Connect();
+	void StartAwait(ConnectAwaitable *awaitable);
+	void ResumeAwaiting(int fd, const std::string &local_addr);
 	void HandleWrite();
 	void HandleError();
 	void OnConnectTimeout();
@@ -97,9 +142,10 @@ private:
 	bool own_fd_;
 	
 	std::unique_ptr<FdChannel> chan_;
-	std::unique_ptr<EventWatcher> timer_;
+	Timer timer_; // The connecting timeout
 	std::shared_ptr<DNSResolver> dns_resolver_;
 	NewConnectionCallback conn_fn_;
+	ConnectAwaitable *awaiting_;
 };
 
 } // namespace evloop
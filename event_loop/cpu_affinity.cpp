@@ -0,0 +1,187 @@
+#include "zrtc/event_loop/cpu_affinity.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "zrtc/event_loop/event_common.h"
+
+namespace evloop {
+
+#ifdef __linux__
+namespace {
+	// From <linux/mempolicy.h>, without depending on libnuma
+	const int kMpolPreferred = 1;
+
+	bool ReadIntFile(const char *path, int *value) {
+		FILE *f = fopen(path, "r");
+		if (f == nullptr) {
+			return false;
+		}
+
+		bool ok = fscanf(f, "%d", value) == 1;
+		fclose(f);
+		return ok;
+	}
+
+	// Logical CPUs grouped by physical core, in the order of their first CPU
+	const std::vector<std::vector<int> > &PhysicalCores() {
+		static const std::vector<std::vector<int> > cores = [] {
+			std::vector<std::pair<int, int> > keys; // (package, core)
+			std::vector<std::vector<int> > result;
+			long n = sysconf(_SC_NPROCESSORS_CONF);
+			char path[128];
+
+			for (int cpu = 0; cpu < n; ++cpu) {
+				int package = 0;
+				int core = 0;
+				snprintf(path, sizeof(path),
+						"/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+				if (!ReadIntFile(path, &package)) {
+					continue; // offline
+				}
+
+				snprintf(path, sizeof(path),
+						"/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+				if (!ReadIntFile(path, &core)) {
+					continue;
+				}
+
+				std::pair<int, int> key(package, core);
+				size_t i = 0;
+				while (i < keys.size() && keys[i] != key) {
+					++i;
+				}
+
+				if (i == keys.size()) {
+					keys.push_back(key);
+					result.push_back(std::vector<int>());
+				}
+
+				result[i].push_back(cpu);
+			}
+
+			return result;
+		}();
+
+		return cores;
+	}
+}
+#endif // __linux__
+
+CpuAffinity CpuAffinity::Cpus(const std::vector<int> &cpus) {
+	CpuAffinity a;
+	a.cpus_ = cpus;
+	return a;
+}
+
+CpuAffinity CpuAffinity::PhysicalCore(int index) {
+	CpuAffinity a;
+#ifdef __linux__
+	const std::vector<std::vector<int> > &cores = PhysicalCores();
+	if (!cores.empty() && index >= 0) {
+		a.cpus_ = cores[index % cores.size()];
+	}
+#endif
+	return a;
+}
+
+int CpuAffinity::PhysicalCoreCount() {
+#ifdef __linux__
+	return static_cast<int>(PhysicalCores().size());
+#else
+	return 0;
+#endif
+}
+
+int CpuAffinity::NumaNodeOfCpu(int cpu) {
+#ifdef __linux__
+	// The cpu directory holds a nodeN link to its NUMA node
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+	DIR *dir = opendir(path);
+	if (dir == nullptr) {
+		return -1;
+	}
+
+	int node = -1;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != nullptr) {
+		if (strncmp(entry->d_name, "node", 4) == 0
+			&& entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+			node = atoi(entry->d_name + 4);
+			break;
+		}
+	}
+
+	closedir(dir);
+	return node;
+#else
+	return -1;
+#endif
+}
+
+int CpuAffinity::numa_node() const {
+	int node = -1;
+
+	for (size_t i = 0; i < cpus_.size(); ++i) {
+		int n = NumaNodeOfCpu(cpus_[i]);
+		if (n < 0 || (node >= 0 && n != node)) {
+			return -1;
+		}
+
+		node = n;
+	}
+
+	return node;
+}
+
+bool CpuAffinity::ApplyToCurrentThread() const {
+	if (cpus_.empty()) {
+		return true;
+	}
+
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (size_t i = 0; i < cpus_.size(); ++i) {
+		if (cpus_[i] >= 0 && cpus_[i] < CPU_SETSIZE) {
+			CPU_SET(cpus_[i], &set);
+		}
+	}
+
+	int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (err != 0) {
+		LOG_T_F(LS_WARNING) << "pthread_setaffinity_np failed, err=" << err;
+		return false;
+	}
+
+	// Prefer the node of the pinned CPUs for the pages this thread faults
+	// in, i.e. the buffers and connections created in the loop. Memory
+	// touched first by another thread stays where it is
+	int node = numa_node();
+	if (node >= 0 && node < static_cast<int>(sizeof(unsigned long) * 8)) {
+		unsigned long mask = 1UL << node;
+		if (syscall(SYS_set_mempolicy, kMpolPreferred, &mask,
+					sizeof(mask) * 8) != 0) {
+			LOG_T_F(LS_WARNING) << "set_mempolicy failed, node=" << node;
+		}
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+} // namespace evloop
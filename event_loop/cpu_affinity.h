@@ -0,0 +1,59 @@
+/*
+ * File:   cpu_affinity.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 4:30 PM
+ */
+
+#ifndef ZRTC_CPU_AFFINITY_H
+#define ZRTC_CPU_AFFINITY_H
+
+#include <vector>
+
+namespace evloop {
+
+// @brief: The set of CPUs an io event thread is pinned to. An empty set
+// means no pinning. Pinning also makes the thread prefer the NUMA node of
+// its CPUs for new memory, so the buffers and connections created in the
+// loop thread stay local to it.
+// @note: Only implemented on Linux, a no-op elsewhere
+class CpuAffinity {
+public:
+	CpuAffinity() {}
+
+	// @brief: Any of the given logical CPUs
+	static CpuAffinity Cpus(const std::vector<int> &cpus);
+
+	// @brief: All the hyper-threads of the index-th physical core, the
+	// index wraps around the number of cores
+	static CpuAffinity PhysicalCore(int index);
+
+	// @brief: Number of physical cores, 0 if unknown
+	static int PhysicalCoreCount();
+
+	// @brief: NUMA node of a logical CPU, -1 if unknown
+	static int NumaNodeOfCpu(int cpu);
+
+public:
+	// @brief: Pin the calling thread and prefer its NUMA node for memory
+	// @return: false if the thread could not be pinned
+	bool ApplyToCurrentThread() const;
+
+	// @brief: The NUMA node of the CPUs, -1 if unknown or several nodes
+	int numa_node() const;
+
+	bool empty() const {
+		return cpus_.empty();
+	}
+
+	const std::vector<int> &cpus() const {
+		return cpus_;
+	}
+
+private:
+	std::vector<int> cpus_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_CPU_AFFINITY_H */
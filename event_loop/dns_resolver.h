@@ -11,6 +11,7 @@
 #include <netinet/in.h>
 
 #include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/loop_allocator.h"
 
 struct evdns_base;
 struct evdns_getaddrinfo_request;
@@ -20,7 +21,7 @@ namespace evloop {
 class EventLoop;
 class TimerEventWatcher;
 
-class DNSResolver {
+class DNSResolver: public LoopAllocated {
 public:
 	typedef std::function<void(std::vector<struct in_addr> &addrs)> Functor;
 	
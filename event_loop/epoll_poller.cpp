@@ -0,0 +1,202 @@
+#include "zrtc/event_loop/epoll_poller.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+#include "zrtc/event_loop/libevent.h"
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/fd_channel.h"
+
+namespace evloop {
+
+#ifdef __linux__
+namespace {
+	const int kInitialEvents = 1024;
+	const int kMaxEvents = 64 * 1024;
+}
+
+EpollPoller::EpollPoller(EventLoop *loop)
+	: loop_(loop)
+	, epfd_(-1)
+	, event_(nullptr)
+	, ctl_count_(0)
+	, events_(nullptr)
+	, nevents_(0)
+	, ready_(0)
+	, next_(0) {
+}
+
+EpollPoller::~EpollPoller() {
+	if (event_) {
+		EventDel(event_);
+		delete event_;
+		event_ = nullptr;
+	}
+
+	if (epfd_ >= 0) {
+		close(epfd_);
+		epfd_ = -1;
+	}
+
+	delete[] events_;
+}
+
+bool EpollPoller::Init() {
+	epfd_ = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd_ < 0) {
+		LOG_T_F(LS_ERROR) << "epoll_create1 failed, errno=" << errno;
+		return false;
+	}
+
+	nevents_ = kInitialEvents;
+	events_ = new struct epoll_event[nevents_];
+
+	// Level-triggered: whatever one Poll() leaves ready wakes the next pass
+	event_ = new event();
+	memset(event_, 0, sizeof(struct event));
+	event_set(event_, epfd_, EV_READ | EV_PERSIST,
+			&EpollPoller::HandlerFn, this);
+	event_base_set(loop_->event_base(), event_);
+	if (EventAdd(event_, nullptr) != 0) {
+		LOG_T_F(LS_ERROR) << "event_add failed for the epoll fd.";
+		return false;
+	}
+
+	return true;
+}
+
+bool EpollPoller::Update(FdChannel *c, int flags, bool edge_triggered,
+						bool registered) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.data.ptr = c;
+	if (flags & FdChannel::kReadable) {
+		ev.events |= EPOLLIN;
+	}
+
+	if (flags & FdChannel::kWritable) {
+		ev.events |= EPOLLOUT;
+	}
+
+	if (edge_triggered) {
+		ev.events |= EPOLLET;
+	}
+
+	++ctl_count_;
+	int op = registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	if (epoll_ctl(epfd_, op, c->fd(), &ev) != 0) {
+		LOG_T_F(LS_ERROR) << "epoll_ctl failed, fd=" << c->fd() << " op=" << op << " errno=" << errno;
+		return false;
+	}
+
+	return true;
+}
+
+void EpollPoller::Remove(FdChannel *c) {
+	// The fd may be closed already, which removed it from the set
+	++ctl_count_;
+	epoll_ctl(epfd_, EPOLL_CTL_DEL, c->fd(), nullptr);
+
+	for (int i = next_; i < ready_; ++i) {
+		if (events_[i].data.ptr == c) {
+			events_[i].data.ptr = nullptr;
+		}
+	}
+}
+
+void EpollPoller::Poll() {
+	int n = epoll_wait(epfd_, events_, nevents_, 0);
+	if (n < 0) {
+		if (errno != EINTR) {
+			LOG_T_F(LS_ERROR) << "epoll_wait failed, errno=" << errno;
+		}
+
+		return;
+	}
+
+	ready_ = n;
+	for (next_ = 0; next_ < ready_;) {
+		struct epoll_event &ev = events_[next_++];
+		FdChannel *c = static_cast<FdChannel *>(ev.data.ptr);
+		if (c == nullptr) {
+			continue;
+		}
+
+		// As libevent does: an error or a hang-up wakes both directions
+		short which = 0;
+		if (ev.events & (EPOLLHUP | EPOLLERR)) {
+			which = FdChannel::kReadable | FdChannel::kWritable;
+		}
+		else {
+			if (ev.events & EPOLLIN) {
+				which |= FdChannel::kReadable;
+			}
+
+			if (ev.events & EPOLLOUT) {
+				which |= FdChannel::kWritable;
+			}
+		}
+
+		// Only the directions the channel asked for
+		which &= c->flags_;
+		if (which != 0) {
+			c->HandleEvent(c->fd(), which);
+		}
+	}
+
+	ready_ = 0;
+	next_ = 0;
+
+	if (n == nevents_ && nevents_ < kMaxEvents) {
+		delete[] events_;
+		nevents_ *= 2;
+		events_ = new struct epoll_event[nevents_];
+	}
+}
+
+void EpollPoller::HandlerFn(int fd, short which, void *v) {
+	EpollPoller *p = (EpollPoller *)v;
+	p->Poll();
+}
+
+#else // __linux__
+
+EpollPoller::EpollPoller(EventLoop *loop)
+	: loop_(loop)
+	, epfd_(-1)
+	, event_(nullptr)
+	, ctl_count_(0)
+	, events_(nullptr)
+	, nevents_(0)
+	, ready_(0)
+	, next_(0) {
+}
+
+EpollPoller::~EpollPoller() {
+}
+
+bool EpollPoller::Init() {
+	return false;
+}
+
+bool EpollPoller::Update(FdChannel *, int, bool, bool) {
+	return false;
+}
+
+void EpollPoller::Remove(FdChannel *) {
+}
+
+void EpollPoller::Poll() {
+}
+
+void EpollPoller::HandlerFn(int, short, void *) {
+}
+
+#endif // __linux__
+
+} // namespace evloop
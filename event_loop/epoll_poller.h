@@ -0,0 +1,73 @@
+/*
+ * File:   epoll_poller.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 9:00 PM
+ */
+
+#ifndef ZRTC_EPOLL_POLLER_H
+#define ZRTC_EPOLL_POLLER_H
+
+#include <cstdint>
+
+#include "zrtc/event_loop/poller.h"
+
+struct event;
+struct epoll_event;
+
+namespace evloop {
+
+class EventLoop;
+
+// @brief: The FdChannel registrations of an EventLoop built with
+// EventLoop::kEpollBackend, kept in an epoll set of their own instead of
+// one libevent event per fd:
+//  - an interest change is one EPOLL_CTL_MOD, not an event_del/event_add,
+//  - a channel may ask for edge-triggered mode,
+//  - the ready list is read into an array sized for thousands of fds.
+//
+// Timers and watchers stay on libevent. The epoll fd is a single
+// persistent libevent read event, so the loop still blocks in one place
+// and drains the channels when the set becomes ready.
+// @note: Linux only, io event thread only
+class EpollPoller: public Poller {
+public:
+	explicit EpollPoller(EventLoop *loop);
+	virtual ~EpollPoller();
+
+	virtual bool Init() override;
+
+	// @brief: One EPOLL_CTL_ADD, or EPOLL_CTL_MOD when registered
+	virtual bool Update(FdChannel *c, int flags, bool edge_triggered,
+						bool registered) override;
+
+	virtual void Remove(FdChannel *c) override;
+
+	// @brief: epoll_ctl calls since Init()
+	virtual uint64_t ctl_count() const override {
+		return ctl_count_;
+	}
+
+private:
+	// @brief: Read the ready list without blocking and run the channels
+	void Poll();
+
+	static void HandlerFn(int fd, short which, void *v);
+
+private:
+	EventLoop *loop_;
+	int epfd_;
+	struct event *event_;
+	uint64_t ctl_count_;
+
+	// The ready list being dispatched, Remove() clears its entries so that
+	// a channel closed by an earlier callback is not run
+	struct epoll_event *events_;
+	int nevents_;
+	int ready_;
+	int next_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_EPOLL_POLLER_H */
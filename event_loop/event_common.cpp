@@ -1,5 +1,7 @@
 #include "zrtc/event_loop/event_common.h"
 
+#include <chrono>
+
 #include "zrtc/event_loop/libevent.h"
 
 namespace evloop {
@@ -11,5 +13,10 @@ int EventAdd(struct event *ev, const struct timeval *timeout) {
 int EventDel(struct event *ev) {
 	return event_del(ev);
 }
+
+int64_t MonotonicMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 	
 } // namespace evloop
\ No newline at end of file
@@ -31,6 +31,9 @@ struct event;
 namespace evloop {
 	int EventAdd(struct event *ev, const struct timeval *timeout);
 	int EventDel(struct event *ev);
+	
+	// @brief: Microseconds from a monotonic clock, for intervals only
+	int64_t MonotonicMicros();
 } // namespace evloop
 
 #endif /* ZRTC_EVENT_LOOP_UTILITY_H */
@@ -1,23 +1,86 @@
 #include "zrtc/event_loop/event_loop.h"
 
+#include <algorithm>
+
 #include "zrtc/event_loop/libevent.h"
 #include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/epoll_poller.h"
+#include "zrtc/event_loop/io_uring_poller.h"
 #include "zrtc/event_loop/event_sockets.h"
 #include "zrtc/event_loop/event_watcher.h"
+#include "zrtc/event_loop/fd_channel.h"
+#include "zrtc/event_loop/keepalive_scheduler.h"
+#include "zrtc/event_loop/loop_allocator.h"
+#include "zrtc/event_loop/tcp_conn.h"
+#include "zrtc/event_loop/timing_wheel.h"
 
 
 namespace evloop {
 
-EventLoop::EventLoop()
-	: create_evbase_myself_(true), notified_(false), pending_functor_count_(0) {
+EventLoop::EventLoop(): EventLoop(kLibeventBackend) {
+}
+
+EventLoop::EventLoop(Backend backend)
+	: create_evbase_myself_(true)
+	, notified_(false)
+	, quit_(false)
+	, accepting_(true)
+	, rejected_count_(0)
+	, draining_(false)
+	, drain_deadline_us_(0)
+	, dropped_output_bytes_(0)
+	, stop_state_(nullptr)
+	, pending_functor_count_(0)
+	, connection_count_(0)
+	, budget_max_count_(0)
+	, budget_max_time_us_(0)
+	, budget_exhausted_count_(0)
+	, budget_deferred_count_(0)
+	, busy_poll_max_us_(0)
+	, busy_poll_spin_us_(0)
+	, busy_poll_idle_avg_us_(0)
+	, now_us_(0) {
 	evbase_ = event_base_new();
 	Init();
+	
+	if (backend == kIoUringBackend) {
+		poller_.reset(new IoUringPoller(this));
+		if (!poller_->Init()) {
+			LOG_T_F(LS_WARNING) << "IoUringPoller init failed, fall back to epoll.";
+			poller_.reset();
+			backend = kEpollBackend;
+		}
+	}
+	
+	if (backend == kEpollBackend) {
+		poller_.reset(new EpollPoller(this));
+		if (!poller_->Init()) {
+			LOG_T_F(LS_WARNING) << "EpollPoller init failed, fall back to libevent.";
+			poller_.reset();
+		}
+	}
 }
 
 EventLoop::EventLoop(struct ::event_base* base)
 	: create_evbase_myself_(false)
 	, notified_(false)
-	, pending_functor_count_(0) {
+	, quit_(false)
+	, accepting_(true)
+	, rejected_count_(0)
+	, draining_(false)
+	, drain_deadline_us_(0)
+	, dropped_output_bytes_(0)
+	, stop_state_(nullptr)
+	, pending_functor_count_(0)
+	, connection_count_(0)
+	, budget_max_count_(0)
+	, budget_max_time_us_(0)
+	, budget_exhausted_count_(0)
+	, budget_deferred_count_(0)
+	, busy_poll_max_us_(0)
+	, busy_poll_spin_us_(0)
+	, busy_poll_idle_avg_us_(0)
+	, now_us_(0) {
 	Init();
 	bool ret = watcher_->AsyncWait();
 	if (!ret) {
@@ -29,22 +92,39 @@ EventLoop::EventLoop(struct ::event_base* base)
 
 EventLoop::~EventLoop() {
 	watcher_.reset();
+	drain_timer_.reset();
+	poller_.reset();
+	keepalive_.reset();
+	wheel_.reset();
+	
+	if (stop_state_ != nullptr) {
+		// Stop(timeout_ms) was called, but the loop did not run it
+		stop_state_->Abandon();
+		stop_state_->Release();
+		stop_state_ = nullptr;
+	}
 	
 	if (evbase_ != nullptr && create_evbase_myself_) {
 		event_base_free(evbase_);
 		evbase_ = nullptr;
 	}
 	
-	delete pending_functors_;
-	pending_functors_ = nullptr;
+	allocator_->Release();
+	allocator_ = nullptr;
 }
 
 void EventLoop::Init() {
 	status_ = kInitializing;
 	
-	pending_functors_ = new std::vector<Functor>();
+	for (int p = 0; p < kTaskPriorityCount; ++p) {
+		lanes_[p].depth = 0;
+		lanes_[p].executed = 0;
+		lanes_[p].total_wait_us = 0;
+		lanes_[p].max_wait_us = 0;
+	}
 	
 	tid_ = std::this_thread::get_id();
+	allocator_ = new LoopAllocator();
 	
 	InitNotifyPipeWatcher();
 	
@@ -52,6 +132,17 @@ void EventLoop::Init() {
 }
 
 void EventLoop::InitNotifyPipeWatcher() {
+#ifdef __linux__
+	// Prefer eventfd: one fd and one read per batch of notifications
+	watcher_.reset(new EventFdWatcher(this,
+					std::bind(&EventLoop::DoPendingFunctors, this)));
+	if (watcher_->Init()) {
+		return;
+	}
+	
+	LOG_T_F(LS_WARNING) << "EventFdWatcher init failed, fall back to PipeEventWatcher.";
+#endif
+	
 	watcher_.reset(new PipeEventWatcher(this,
 					std::bind(&EventLoop::DoPendingFunctors, this)));
 	bool ret = watcher_->Init();
@@ -65,14 +156,55 @@ void EventLoop::Run() {
 	status_ = kStarting;
 	tid_ = std::this_thread::get_id();
 	
+	// Events, channels and timers created on this thread come from the slabs
+	LoopAllocator::Scope allocator_scope(allocator_);
+	
+	if (!affinity_.empty() && !affinity_.ApplyToCurrentThread()) {
+		LOG_T_F(LS_WARNING) << "EventLoop could not be pinned, run unpinned.";
+	}
+	
 	bool ret = watcher_->AsyncWait();
 	if (!ret) {
 		//LOG_T_F(LS_ERROR) << "PipeEventWatcher init failed.";
 	}
 	
 	status_ = kRunning;
+	stats_.heartbeat()->AttachThread();
+	
+	// Same as event_base_dispatch, one pass at a time so that every
+	// iteration can be measured
+	int running = 0;
+	quit_ = false;
+	while (!quit_) {
+		int64_t begin_us = stats_.Now();
+		PrepareToPoll();
+		if (draining_) {
+			// Stop(timeout_ms): drain_timer_ ends the wait at the deadline
+			running = event_base_loop(evbase_, EVLOOP_ONCE);
+		}
+		else if (!idle_functors_.empty()) {
+			running = IdlePollOnce();
+		}
+		else if (busy_poll_max_us_ > 0) {
+			running = BusyPollOnce();
+		}
+		else {
+			running = event_base_loop(evbase_, EVLOOP_ONCE);
+		}
+		
+		DoEndOfIterationFunctors();
+		stats_.AddIteration(begin_us);
+		stats_.heartbeat()->Beat();
+		
+		if (draining_) {
+			CheckDrain();
+		}
+		
+		if (running != 0) {
+			break;
+		}
+	}
 	
-	auto running = event_base_dispatch(evbase_);
 	if (running == 1) {
 		//LOG_T_F(LS_ERROR) << "event_base_dispatch error: no event registered";
 	}
@@ -87,13 +219,6 @@ void EventLoop::Run() {
 	status_ = kStopped;
 }
 
-InvokeTimerPtr EventLoop::RunAfter(int delay_ms, const Functor &f) {
-	//LOG_T_F(LS_INFO) << "";
-	std::shared_ptr<InvokeTimer> t = InvokeTimer::Create(this, delay_ms, f, false);
-    t->Start();
-    return t;
-}
-
 InvokeTimerPtr EventLoop::RunAfter(int delay_ms, Functor &&f) {
 	//LOG_T_F(LS_INFO) << "";
 	std::shared_ptr<InvokeTimer> t = InvokeTimer::Create(this, delay_ms, std::move(f), false);
@@ -101,20 +226,44 @@ InvokeTimerPtr EventLoop::RunAfter(int delay_ms, Functor &&f) {
     return t;
 }
 
-InvokeTimerPtr EventLoop::RunEvery(int time_ms, const Functor &f) {
+InvokeTimerPtr EventLoop::RunEvery(int time_ms, Functor &&f) {
 	//LOG_T_F(LS_INFO) << "";
-	std::shared_ptr<InvokeTimer> t = InvokeTimer::Create(this, time_ms, f, true);
+	std::shared_ptr<InvokeTimer> t = InvokeTimer::Create(this, time_ms, std::move(f), true);
 	t->Start();
 	return t;
 }
 
-InvokeTimerPtr EventLoop::RunEvery(int time_ms, Functor &&f) {
-	//LOG_T_F(LS_INFO) << "";
-	std::shared_ptr<InvokeTimer> t = InvokeTimer::Create(this, time_ms, std::move(f), true);
+InvokeTimerPtr EventLoop::RunEvery(int time_ms, Functor &&f,
+								const PeriodicOptions &options) {
+	std::shared_ptr<InvokeTimer> t = InvokeTimer::Create(this, time_ms, std::move(f), options);
 	t->Start();
 	return t;
 }
 
+InvokeTimerPtr EventLoop::RunAfter(std::chrono::microseconds delay, Functor &&f) {
+	std::shared_ptr<InvokeTimer> t = InvokeTimer::Create(this, delay, std::move(f), false);
+	t->Start();
+	return t;
+}
+
+InvokeTimerPtr EventLoop::RunEvery(std::chrono::microseconds period, Functor &&f) {
+	std::shared_ptr<InvokeTimer> t = InvokeTimer::Create(this, period, std::move(f), true);
+	t->Start();
+	return t;
+}
+
+void EventLoop::EnableTimingWheel() {
+	if (wheel_) {
+		return;
+	}
+	
+	wheel_.reset(new TimingWheel(this));
+	if (!wheel_->Init()) {
+		LOG_T_F(LS_WARNING) << "TimingWheel init failed, timers stay on libevent.";
+		wheel_.reset();
+	}
+}
+
 void EventLoop::Stop() {
 	//LOG_T_F(LS_INFO) << "";
 	assert(status_ == kRunning);
@@ -134,63 +283,335 @@ void EventLoop::StopInLoop() {
 	
 	f();
 	
-	event_base_loopexit(evbase_, nullptr);
+	quit_ = true;
+	event_base_loopbreak(evbase_);
 	
 	f();
 }
 
-void EventLoop::RunInLoop(const Functor& f) {
-	//LOG_T_F(LS_INFO) << "";
-	if (IsRunning() && IsInLoopThread()) {
-		f();
+Future<EventLoop::StopResult> EventLoop::Stop(int64_t timeout_ms) {
+	assert(status_ == kRunning);
+	status_ = kStopping;
+	
+	// One reference for the future, one for the loop
+	stop_state_ = new FutureState<StopResult>();
+	Future<StopResult> future(stop_state_);
+	
+	int64_t deadline_us = MonotonicMicros() + timeout_ms * 1000;
+	QueueInLoop([this, deadline_us]() {
+		DrainInLoop(deadline_us);
+	}, kUrgent);
+	
+	// After queueing DrainInLoop, which has to get in
+	accepting_ = false;
+	
+	return future;
+}
+
+void EventLoop::DrainInLoop(int64_t deadline_us) {
+	assert(status_ == kStopping);
+	draining_ = true;
+	drain_deadline_us_ = deadline_us;
+	dropped_output_bytes_ = 0;
+	
+	// Nothing to do but wake the loop up, CheckDrain() sees the time is up
+	int64_t remaining_us = deadline_us - MonotonicMicros();
+	drain_timer_.reset(new TimerEventWatcher(this, []() {},
+			std::chrono::microseconds(remaining_us > 0 ? remaining_us : 1)));
+	if (!drain_timer_->Init() || !drain_timer_->AsyncWait()) {
+		LOG_T_F(LS_ERROR) << "drain timer failed to start";
 	}
-	else {
-		QueueInLoop(f);
+}
+
+void EventLoop::CheckDrain() {
+	bool drained = pending_functor_count_.load() == 0
+				&& end_of_iteration_functors_.empty();
+	for (size_t i = 0; drained && i < connections_.size(); ++i) {
+		// Flushed when the socket becomes writable, which wakes us up
+		drained = connections_[i]->output_backlog_bytes() == 0;
+	}
+	
+	if (!drained && MonotonicMicros() < drain_deadline_us_) {
+		return;
+	}
+	
+	StopResult r;
+	r.drained = drained;
+	// The closes below throw away what is still pending, counted here
+	// already
+	r.dropped_bytes = dropped_output_bytes_;
+	r.closed_connections = static_cast<int>(connections_.size());
+	
+	// Closing a connection detaches it, and may destroy it
+	std::vector<TcpConnPtr> conns;
+	for (size_t i = 0; i < connections_.size(); ++i) {
+		r.dropped_bytes += connections_[i]->output_backlog_bytes();
+		conns.push_back(connections_[i]->shared_from_this());
 	}
+	
+	r.dropped_tasks = DropPendingFunctors()
+					+ end_of_iteration_functors_.size()
+					+ idle_functors_.size();
+	end_of_iteration_functors_.clear();
+	idle_functors_.clear();
+	
+	for (size_t i = 0; i < conns.size(); ++i) {
+		conns[i]->ForceClose();
+	}
+	
+	conns.clear();
+	
+	// One pass for what the closes queued, e.g. the timer cancels. What
+	// that pass queues in turn is dropped
+	DoPendingFunctors();
+	r.dropped_tasks += DropPendingFunctors() + rejected_count_.load();
+	
+	draining_ = false;
+	drain_timer_.reset();
+	quit_ = true;
+	
+	FutureState<StopResult> *state = stop_state_;
+	stop_state_ = nullptr;
+	auto f = [&r]() {
+		return r;
+	};
+	state->Run(f);
+	state->Release();
 }
 
-void EventLoop::RunInLoop(Functor&& f) {
-	//LOG_T_F(LS_INFO) << "";
-	if (IsRunning() && IsInLoopThread()) {
-		f();
+uint64_t EventLoop::DropPendingFunctors() {
+	uint64_t dropped = 0;
+	PendingTask task;
+	
+	bool popped = true;
+	while (popped) {
+		popped = false;
+		for (int p = 0; p < kTaskPriorityCount; ++p) {
+			Lane &lane = lanes_[p];
+			while (lane.queue.Pop(&task)) {
+				--lane.depth;
+				--pending_functor_count_;
+				++dropped;
+				popped = true;
+				
+				// Its destructor may queue another functor
+				task.functor = Functor();
+			}
+		}
 	}
-	else {
-		QueueInLoop(std::move(f));
+	
+	return dropped;
+}
+
+void EventLoop::AttachConnection(TcpConn *conn) {
+	assert(IsInLoopThread());
+	connections_.push_back(conn);
+}
+
+void EventLoop::DetachConnection(TcpConn *conn) {
+	assert(IsInLoopThread());
+	std::vector<TcpConn *>::iterator it =
+			std::find(connections_.begin(), connections_.end(), conn);
+	if (it != connections_.end()) {
+		*it = connections_.back();
+		connections_.pop_back();
 	}
 }
 
-void EventLoop::QueueInLoop(const Functor &f) {
-	//LOG_T_F(LS_INFO) << "";
-	{
-		std::lock_guard<std::mutex> lock(mutex_);
-		pending_functors_->emplace_back(f);
+KeepaliveScheduler *EventLoop::keepalive_scheduler() {
+	assert(IsInLoopThread());
+	if (!keepalive_) {
+		keepalive_.reset(new KeepaliveScheduler(this));
 	}
 	
-	++pending_functor_count_;
+	return keepalive_.get();
+}
+
+void EventLoop::QueueChannelUpdate(FdChannel *c) {
+	assert(IsInLoopThread());
+	channel_updates_.push_back(c);
+}
+
+void EventLoop::CancelChannelUpdate(FdChannel *c) {
+	std::vector<FdChannel *>::iterator it =
+		std::find(channel_updates_.begin(), channel_updates_.end(), c);
+	if (it != channel_updates_.end()) {
+		channel_updates_.erase(it);
+	}
+}
+
+void EventLoop::PrepareToPoll() {
+	// A channel is queued once however many times it flipped, and skipped
+	// here if it ended where it started
+	for (size_t i = 0; i < channel_updates_.size(); ++i) {
+		channel_updates_[i]->ApplyUpdate();
+	}
+	
+	channel_updates_.clear();
+	
+	if (poller_) {
+		poller_->Flush();
+	}
+	
+	// The poll may block, NowMicros() reads the clock again after it
+	now_us_ = 0;
+}
+
+void EventLoop::RunWhenIdle(Functor &&f) {
+	assert(IsInLoopThread());
+	idle_functors_.push_back(std::move(f));
+}
+
+void EventLoop::RunAtEndOfIteration(Functor &&f) {
+	assert(IsInLoopThread());
+	end_of_iteration_functors_.push_back(std::move(f));
+}
+
+int EventLoop::IdlePollOnce() {
+	uint64_t callbacks = stats_.callback_count();
 	
-	if (!notified_) {
+	int running = event_base_loop(evbase_, EVLOOP_ONCE | EVLOOP_NONBLOCK);
+	if (running != 0 || stats_.callback_count() != callbacks) {
+		// Not idle, try again on the next pass
+		return running;
+	}
+	
+	CallbackStatsScope scope(&stats_, LoopStatsCollector::kFunctorCallback);
+	
+	// Functors added by the idle ones wait for the next idle pass
+	std::vector<Functor> functors;
+	functors.swap(idle_functors_);
+	for (size_t i = 0; i < functors.size(); ++i) {
+		RunFunctor(functors[i]);
+	}
+	
+	return 0;
+}
+
+void EventLoop::DoEndOfIterationFunctors() {
+	if (end_of_iteration_functors_.empty()) {
+		return;
+	}
+	
+	CallbackStatsScope scope(&stats_, LoopStatsCollector::kFunctorCallback);
+	
+	// Functors added by these ones still run in this iteration
+	while (!end_of_iteration_functors_.empty()) {
+		std::vector<Functor> functors;
+		functors.swap(end_of_iteration_functors_);
+		for (size_t i = 0; i < functors.size(); ++i) {
+			RunFunctor(functors[i]);
+		}
+	}
+}
+
+int EventLoop::BusyPollOnce() {
+	int64_t begin_us = MonotonicMicros();
+	
+	if (busy_poll_spin_us_ > 0) {
+		uint64_t callbacks = stats_.callback_count();
+		int64_t deadline_us = begin_us + busy_poll_spin_us_;
+		int64_t now_us = begin_us;
+		bool found_work = false;
+		
+		// The producers see notified_ == true and skip the wakeup write
+		// while we are spinning, we look at the queue ourselves. So the
+		// spin runs the functors without DoPendingFunctors, which would
+		// reset the flag
 		notified_ = true;
-		if (watcher_.get()) {
-			watcher_->Notify();
+		
+		while (!found_work && now_us < deadline_us) {
+			if (pending_functor_count_.load() > 0) {
+				RunPendingFunctors();
+			}
+			
+			PrepareToPoll();
+			int running = event_base_loop(evbase_, EVLOOP_ONCE | EVLOOP_NONBLOCK);
+			if (running != 0) {
+				notified_ = false;
+				return running;
+			}
+			
+			// A wakeup written before the spin ran the watcher, which reset
+			// the flag
+			notified_ = true;
+			
+			now_us = MonotonicMicros();
+			found_work = stats_.callback_count() != callbacks;
 		}
-		else {
-			//LOG_T_F(LS_INFO) << "status=" << StatusToString();
-			assert(!IsRunning());
+		
+		// Done spinning: let the producers notify again. Both sides use
+		// seq_cst, so either they see notified_ == false and notify, or we
+		// see their functor here
+		notified_ = false;
+		if (pending_functor_count_.load() > 0) {
+			DoPendingFunctors();
+			found_work = true;
+		}
+		
+		if (found_work) {
+			AdaptBusyPoll(now_us - begin_us);
+			return 0;
 		}
 	}
+	
+	PrepareToPoll();
+	int running = event_base_loop(evbase_, EVLOOP_ONCE);
+	
+	// It includes the time of the callbacks run after the wakeup, which is
+	// small compared to the idle time on the paths that want busy-polling
+	AdaptBusyPoll(MonotonicMicros() - begin_us);
+	
+	return running;
+}
+
+void EventLoop::AdaptBusyPoll(int64_t idle_us) {
+	// Moving average with a weight of 1/8 for the new sample
+	busy_poll_idle_avg_us_ += (idle_us - busy_poll_idle_avg_us_) / 8;
+	
+	if (busy_poll_idle_avg_us_ > busy_poll_max_us_) {
+		// Work arrives more rarely than we can afford to spin for
+		busy_poll_spin_us_ = 0;
+	}
+	else {
+		busy_poll_spin_us_ = std::min(busy_poll_max_us_,
+									2 * busy_poll_idle_avg_us_ + 1);
+	}
 }
 
-void EventLoop::QueueInLoop(Functor&& f) {
+void EventLoop::RunInLoop(Functor&& f, TaskPriority priority) {
 	//LOG_T_F(LS_INFO) << "";
-	{
-		std::lock_guard<std::mutex> lock(mutex_);
-		pending_functors_->emplace_back(std::move(f));
+	if (IsRunning() && IsInLoopThread()) {
+		f();
+	}
+	else {
+		QueueInLoop(std::move(f), priority);
 	}
+}
+
+void EventLoop::QueueInLoop(Functor&& f, TaskPriority priority) {
+	//LOG_T_F(LS_INFO) << "";
+	if (!accepting_.load() && !IsInLoopThread()) {
+		// Stop(timeout_ms) is draining the loop, f is dropped here
+		++rejected_count_;
+		return;
+	}
+	
+	Lane &lane = lanes_[priority];
 	
+	PendingTask task;
+	task.functor = std::move(f);
+	task.enqueue_us = MonotonicMicros();
+	lane.queue.Push(std::move(task));
+	
+	++lane.depth;
 	++pending_functor_count_;
 	
-	if (!notified_) {
-		notified_ = true;
+	NotifyIfNeeded();
+}
+
+void EventLoop::NotifyIfNeeded() {
+	if (!notified_.exchange(true)) {
 		if (watcher_.get()) {
 			watcher_->Notify();
 		}
@@ -202,26 +623,109 @@ void EventLoop::QueueInLoop(Functor&& f) {
 }
 
 void EventLoop::DoPendingFunctors() {
-	std::vector<Functor> functors;
-	{
-		std::lock_guard<std::mutex> lock(mutex_);
-		notified_ = false;
-		pending_functors_->swap(functors);
+	// Reset the flag before popping: a producer that pushes from now on
+	// will notify again, so nothing is left behind until the next wakeup
+	notified_ = false;
+	
+	RunPendingFunctors();
+}
+
+void EventLoop::RunPendingFunctors() {
+	CallbackStatsScope scope(&stats_, LoopStatsCollector::kFunctorCallback);
+	
+	// Only run what was queued before this call. Functors queued by the
+	// running ones are handled on the next wakeup
+	int counts[kTaskPriorityCount];
+	int count = 0;
+	for (int p = 0; p < kTaskPriorityCount; ++p) {
+		counts[p] = lanes_[p].depth.load();
+		count += counts[p];
+	}
+	
+	stats_.AddQueueDepth(count);
+	
+	int limit = count;
+	if (budget_max_count_ > 0 && limit > budget_max_count_) {
+		limit = budget_max_count_;
 	}
 	
-	for (std::vector<Functor>::size_type i = 0; i < functors.size(); ++i) {
-		//LOG_T_F(LS_INFO) << "Doing functor #" << i;
-		functors[i]();
-		--pending_functor_count_;
+	int64_t deadline_us = 0;
+	if (budget_max_time_us_ > 0) {
+		deadline_us = MonotonicMicros() + budget_max_time_us_;
 	}
+	
+	int done = 0;
+	bool out_of_budget = false;
+	PendingTask task;
+	for (int p = 0; p < kTaskPriorityCount && !out_of_budget; ++p) {
+		Lane &lane = lanes_[p];
+		
+		for (int i = 0; i < counts[p]; ++i) {
+			// Always run at least one functor so that the queue makes progress
+			if (done == limit
+				|| (deadline_us != 0 && done > 0 && MonotonicMicros() >= deadline_us)) {
+				out_of_budget = true;
+				break;
+			}
+			
+			if (!lane.queue.Pop(&task)) {
+				break;
+			}
+			
+			--lane.depth;
+			--pending_functor_count_;
+			++done;
+			
+			int64_t wait_us = MonotonicMicros() - task.enqueue_us;
+			lane.executed.fetch_add(1, std::memory_order_relaxed);
+			lane.total_wait_us.fetch_add(wait_us, std::memory_order_relaxed);
+			if (wait_us > lane.max_wait_us.load(std::memory_order_relaxed)) {
+				lane.max_wait_us.store(wait_us, std::memory_order_relaxed);
+			}
+			stats_.AddQueueWait(wait_us);
+			
+			//LOG_T_F(LS_INFO) << "Doing functor #" << done;
+			RunFunctor(task.functor);
+			task.functor = Functor();
+		}
+	}
+	
+	if (out_of_budget) {
+		// Let the poller run the ready I/O callbacks first and come back
+		// for the rest on the next loop pass
+		++budget_exhausted_count_;
+		budget_deferred_count_ += count - done;
+		NotifyIfNeeded();
+	}
+}
+
+void EventLoop::RunFunctor(Functor &f) {
+	// The batch is one callback for the stats, the heartbeat shows which
+	// functor of it is running
+	HeartbeatScope beat(stats_.heartbeat(),
+						LoopStatsCollector::kFunctorCallback,
+						reinterpret_cast<intptr_t>(&f),
+						f.invoke_address());
+	f();
+}
+
+EventLoop::LaneStats EventLoop::GetLaneStats(TaskPriority priority) {
+	Lane &lane = lanes_[priority];
+	
+	LaneStats stats;
+	stats.depth = lane.depth.load();
+	stats.executed = lane.executed.load(std::memory_order_relaxed);
+	stats.total_wait_us = lane.total_wait_us.load(std::memory_order_relaxed);
+	stats.max_wait_us = lane.max_wait_us.exchange(0, std::memory_order_relaxed);
+	return stats;
 }
 
 size_t EventLoop::GetPendingQueueSize() {
-	return pending_functors_->size();
+	return static_cast<size_t>(pending_functor_count_.load());
 }
 
 bool EventLoop::IsPendingQueueEmpty() {
-	return pending_functors_->empty();
+	return pending_functor_count_.load() == 0;
 }
 
 } // namespace evloop
\ No newline at end of file
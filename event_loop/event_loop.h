@@ -9,28 +9,80 @@
 #define ZRTC_EVENT_LOOP_H
 
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
 
+#include "zrtc/event_loop/awaitable.h"
+#include "zrtc/event_loop/cpu_affinity.h"
 #include "zrtc/event_loop/event_status.h"
+#include "zrtc/event_loop/future.h"
 #include "zrtc/event_loop/invoke_timer.h"
+#include "zrtc/event_loop/loop_stats.h"
+#include "zrtc/event_loop/task.h"
+#include "zrtc/event_loop/task_queue.h"
 
 struct event_base;
 
 namespace evloop {
 
 class EventWatcher;
+class FdChannel;
+class KeepaliveScheduler;
+class LoopAllocator;
+class Poller;
+class TcpConn;
+class TimingWheel;
 
 class EventLoop: public EventStatus {
 public:
-	typedef std::function<void()> Functor;
+	typedef Task Functor;
+	
+	// Cross-thread functors are queued per priority. DoPendingFunctors
+	// drains kUrgent first, then kNormal, then kBulk, so that control
+	// operations (close, cancel, connection switch) do not wait behind
+	// queued data sends
+	enum TaskPriority {
+		kUrgent = 0,
+		kNormal = 1,
+		kBulk = 2,
+	};
+	
+	static const int kTaskPriorityCount = 3;
+	
+	// Where the FdChannels are registered. Timers and watchers always use
+	// libevent
+	enum Backend {
+		kLibeventBackend = 0, // one libevent event per channel
+		kEpollBackend = 1,    // an epoll set of the loop, see EpollPoller
+		kIoUringBackend = 2,  // batched io_uring polls, see IoUringPoller
+	};
+	
+	struct LaneStats {
+		int depth;              // functors waiting in the lane now
+		uint64_t executed;      // functors run since the loop started
+		int64_t total_wait_us;  // sum of enqueue-to-run times
+		int64_t max_wait_us;    // worst enqueue-to-run time since last read
+	};
+	
+	// @brief: Outcome of Stop(timeout_ms)
+	struct StopResult {
+		bool drained;            // all the work was done before the deadline
+		uint64_t dropped_tasks;  // functors destroyed without running
+		uint64_t dropped_bytes;  // bytes given to TcpConn::Send, never written
+		int closed_connections;  // connections still open at the end
+	};
 	
 public:
 	EventLoop();
 	
+	// @brief: A native backend that cannot start falls back to the next
+	// one: kIoUringBackend to kEpollBackend to kLibeventBackend
+	explicit EventLoop(Backend backend);
+	
 	// Construct EventLoop from an existing event_base object
 	// Possibly embed EventLoop into the current event_base structure
 	explicit EventLoop(struct ::event_base *base);
@@ -41,26 +93,175 @@ public:
 	// @note: It must be called in the io event thread
 	void Run();
 	
-    InvokeTimerPtr RunAfter(int delay_ms, const Functor &f);
+	// @note: Functor is move-only. Lambdas and std::bind results convert
+	// to it implicitly, a named Functor has to be std::move'd in
+	// @note: With EnableTimingWheel() the timers go to the wheel
 	InvokeTimerPtr RunAfter(int delay_ms, Functor &&f);
 	
-	InvokeTimerPtr RunEvery(int time_ms, const Functor &f);
 	InvokeTimerPtr RunEvery(int time_ms, Functor &&f);
 	
+	// @brief: RunEvery with fixed rate, jitter or phase, see PeriodicOptions
+	InvokeTimerPtr RunEvery(int time_ms, Functor &&f,
+							const PeriodicOptions &options);
+	
+	// @brief: High resolution timers, for pacing and RTT/jitter probes:
+	// loop->RunAfter(std::chrono::microseconds(2500), f) fires on a
+	// timerfd(CLOCK_MONOTONIC), not at libevent's next millisecond.
+	// A periodic one keeps its rate whatever the callbacks take
+	// @note: Each timer holds an fd, and the TimingWheel does not apply
+	InvokeTimerPtr RunAfter(std::chrono::microseconds delay, Functor &&f);
+	
+	InvokeTimerPtr RunEvery(std::chrono::microseconds period, Functor &&f);
+	
+	// @brief: Schedule the InvokeTimers of this loop on a TimingWheel
+	// instead of one libevent timer each: O(1) start, cancel and expiry for
+	// the loops with many thousands of timers
+	// @note: Call it before Run() and before the first RunAfter/RunEvery
+	void EnableTimingWheel();
+	
+	// @brief: null unless EnableTimingWheel() was called
+	TimingWheel *timing_wheel() const {
+		return wheel_.get();
+	}
+	
+	// @brief: co_await loop->Sleep(ms) resumes the coroutine after delay_ms
+	// @note: It must be awaited in the io event thread
+	SleepAwaitable Sleep(int delay_ms) {
+		return SleepAwaitable(this, delay_ms);
+	}
+	
 	// @brief: Stop the event loop
 	void Stop();
 	
-	void RunInLoop(const Functor &f);
-	void QueueInLoop(const Functor &f);
+	// @brief: Stop within timeout_ms, e.g. for a rolling restart:
+	// 1. functors queued from other threads are refused from now on,
+	// 2. the loop keeps running until the queued functors and the output
+	//    of its connections, with what TcpConn::SetOutputPendingCallback
+	//    reports, are done or the deadline passes; a poll does not block
+	//    past the deadline,
+	// 3. the connections still open are closed and the leftover functors
+	//    dropped.
+	// The future is ready at step 3, in the io event thread, just before
+	// the loop leaves Run()
+	Future<StopResult> Stop(int64_t timeout_ms);
+	
+	void RunInLoop(Functor &&f, TaskPriority priority = kNormal);
+	void QueueInLoop(Functor &&f, TaskPriority priority = kNormal);
+	
+	// @brief: RunInLoop that hands the result of f back through a Future.
+	// The functor and the result share a single allocation
+	template <typename F>
+	Future<typename std::result_of<typename std::decay<F>::type()>::type>
+	Submit(F &&f, TaskPriority priority = kNormal) {
+		typedef typename std::decay<F>::type D;
+		typedef typename std::result_of<D()>::type R;
+		
+		SubmitState<R, D> *state = new SubmitState<R, D>(D(std::forward<F>(f)));
+		Future<R> future(state);
+		RunInLoop(SubmitFunctor<R, D>(state), priority);
+		return future;
+	}
+	
+	// @brief: Run f in the io event thread and block until it returns
+	// @note: The loop must be running, or Stop() must not have drained it
+	// yet, otherwise the caller blocks until the loop is destroyed
+	template <typename F>
+	typename std::result_of<typename std::decay<F>::type()>::type
+	RunInLoopAndWait(F &&f, TaskPriority priority = kNormal) {
+		return Submit(std::forward<F>(f), priority).get();
+	}
+	
+	// @brief: Run f once, the next time a loop pass finds no ready I/O,
+	// timer or queued functor. Under constant load it keeps waiting
+	// @note: It must be called in the io event thread
+	void RunWhenIdle(Functor &&f);
+	
+	// @brief: Run f once, after all the events ready in the current loop
+	// pass have been dispatched, e.g. to flush the writes the pass
+	// produced in one go
+	// @note: It must be called in the io event thread
+	void RunAtEndOfIteration(Functor &&f);
+	
+	// @brief: Bound the work done by one DoPendingFunctors pass so that a
+	// burst of queued functors can not starve the socket callbacks. The
+	// leftover functors are run on the next loop pass.
+	// @param max_count: functors per pass, 0 for no limit
+	// @param max_time_us: wall time per pass in microseconds, 0 for no limit
+	// @note: Call it before Run() or in the io event thread
+	void SetPendingFunctorBudget(int max_count, int64_t max_time_us) {
+		budget_max_count_ = max_count;
+		budget_max_time_us_ = max_time_us;
+	}
+	
+	// @brief: Opt-in hybrid polling for latency sensitive loops. Before
+	// blocking in the poller the loop spins with non-blocking polls and
+	// checks of the functor queue, for at most max_spin_us. The actual spin
+	// time follows the recent idle gaps: about twice their moving average,
+	// or no spinning at all while the gaps are longer than max_spin_us.
+	// @param max_spin_us: 0 to always block (the default)
+	// @note: It burns a core while spinning. Call it before Run()
+	void SetBusyPoll(int64_t max_spin_us) {
+		busy_poll_max_us_ = max_spin_us;
+		busy_poll_spin_us_ = max_spin_us;
+		busy_poll_idle_avg_us_ = 0;
+	}
+	
+	// @brief: Pin the thread that calls Run() to these CPUs, e.g.
+	// CpuAffinity::PhysicalCore(i) for one loop per physical core
+	// @note: Call it before Run()
+	void SetCpuAffinity(const CpuAffinity &affinity) {
+		affinity_ = affinity;
+	}
+	
+	const CpuAffinity &cpu_affinity() const {
+		return affinity_;
+	}
 	
-	void RunInLoop(Functor &&f);
-	void QueueInLoop(Functor &&f);
+	// @brief: The spin time chosen for the next loop pass
+	int64_t busy_poll_spin_us() const {
+		return busy_poll_spin_us_;
+	}
 	
 public:
 	struct event_base *event_base() const {
 		return evbase_;
 	}
 	
+	// @brief: The native backend in use, null with libevent
+	Poller *poller() const {
+		return poller_.get();
+	}
+	
+	// @brief: The slab allocator serving this loop's thread while it runs
+	LoopAllocator *allocator() const {
+		return allocator_;
+	}
+	
+	// @brief: Monotonic time cached per loop iteration, in microseconds.
+	// The clock is read by the first call after the loop wakes up, every
+	// later call in the same iteration returns that value. Good enough for
+	// timestamps, RTT and timeouts
+	// @note: io event thread only
+	int64_t NowMicros() {
+		if (now_us_ == 0) {
+			UpdateNow();
+		}
+		
+		return now_us_;
+	}
+	
+	// @brief: NowMicros() in milliseconds
+	int64_t Now() {
+		return NowMicros() / 1000;
+	}
+	
+	// @brief: Read CLOCK_MONOTONIC again, for a caller that needs the time
+	// after a long callback
+	int64_t UpdateNow() {
+		now_us_ = MonotonicMicros();
+		return now_us_;
+	}
+	
 	bool IsInLoopThread() const {
 		return tid_ == std::this_thread::get_id();
 	}
@@ -69,6 +270,72 @@ public:
 		return pending_functor_count_.load();
 	}
 	
+	// @brief: Number of live TcpConns bound to this loop
+	int connection_count() const {
+		return connection_count_.load();
+	}
+	
+	void IncConnectionCount() {
+		++connection_count_;
+	}
+	
+	void DecConnectionCount() {
+		--connection_count_;
+	}
+	
+	// @brief: Apply the interest change of c before the next poll
+	// @note: io event thread only, called by FdChannel
+	void QueueChannelUpdate(FdChannel *c);
+	void CancelChannelUpdate(FdChannel *c);
+	
+	// @brief: Track a connected TcpConn, Stop(timeout_ms) closes it
+	// @note: io event thread only, called by TcpConn
+	void AttachConnection(TcpConn *conn);
+	void DetachConnection(TcpConn *conn);
+	
+	// @brief: Bytes given to TcpConn::Send that a closed connection threw
+	// away, reported in StopResult::dropped_bytes
+	// @note: io event thread only, called by TcpConn
+	void AddDroppedOutput(int64_t bytes) {
+		dropped_output_bytes_ += bytes;
+	}
+	
+	// @brief: The pings of this loop's TcpConns, created on first use
+	// @note: io event thread only
+	KeepaliveScheduler *keepalive_scheduler();
+	
+	// @brief: How many DoPendingFunctors passes stopped on the budget
+	uint64_t budget_exhausted_count() const {
+		return budget_exhausted_count_.load();
+	}
+	
+	// @brief: Functors left for a later pass, summed over the passes that
+	// ran out of budget (a functor deferred twice is counted twice)
+	uint64_t budget_deferred_count() const {
+		return budget_deferred_count_.load();
+	}
+	
+	// @brief: Depth and wait time of one priority lane
+	// @note: It resets max_wait_us
+	LaneStats GetLaneStats(TaskPriority priority);
+	
+	// @brief: Iterations, poll vs callback time and latency histograms
+	// @note: It is thread safe and cheap enough to scrape every second.
+	// Empty unless built with ZRTC_EVLOOP_STATS
+	LoopStats GetStats() {
+		return stats_.Snapshot();
+	}
+	
+	// @brief: Used by the watchers and channels to time their callbacks
+	LoopStatsCollector *stats_collector() {
+		return &stats_;
+	}
+	
+	// @brief: The running callback, watched by a LoopWatchdog
+	LoopHeartbeat *heartbeat() {
+		return stats_.heartbeat();
+	}
+	
 	const std::thread::id & tid() const {
 		return tid_;
 	}
@@ -83,8 +350,45 @@ private:
 	// @brief: Stop the event loop in the io event thread
 	void StopInLoop();
 	
+	// @brief: Start the bounded drain of Stop(timeout_ms)
+	void DrainInLoop(int64_t deadline_us);
+	
+	// @brief: Finish the drain once the work is done or the time is up
+	void CheckDrain();
+	
+	// @brief: Destroy the queued functors without running them
+	// @return: how many there were
+	uint64_t DropPendingFunctors();
+	
+	// @brief: One loop pass of the busy-poll mode: spin, then block
+	// @return: same as event_base_loop
+	int BusyPollOnce();
+	
+	// @brief: Feed the idle time before the last work into the spin time
+	void AdaptBusyPoll(int64_t idle_us);
+	
+	// @brief: One loop pass when idle functors wait: a non-blocking poll,
+	// then the idle functors if it found nothing
+	int IdlePollOnce();
+	
+	void DoEndOfIterationFunctors();
+	
+	// @brief: Called before every poll: applies the queued FdChannel
+	// updates, hands the poller its submissions and expires the cached time
+	void PrepareToPoll();
+	
 	void DoPendingFunctors();
 	
+	// @brief: DoPendingFunctors without resetting notified_, for the spin
+	// of BusyPollOnce
+	void RunPendingFunctors();
+	
+	// @brief: Run one queued, idle or end-of-iteration functor
+	void RunFunctor(Functor &f);
+	
+	// @brief: Wake up the io event thread if nobody did it yet
+	void NotifyIfNeeded();
+	
 	size_t GetPendingQueueSize();
 	
 	bool IsPendingQueueEmpty();
@@ -95,17 +399,88 @@ private:
 	
 	std::thread::id tid_;
 	
-	std::mutex mutex_;
-	
 	// Used to notify the thread when we push a task into queue
 	std::unique_ptr<EventWatcher> watcher_;
 	
+	std::unique_ptr<Poller> poller_;
+	
+	std::unique_ptr<TimingWheel> wheel_;
+	
+	std::unique_ptr<KeepaliveScheduler> keepalive_;
+	
+	// Released last, it goes once the objects it holds are freed
+	LoopAllocator *allocator_;
+	
+	// FdChannels whose interest changed since the last poll
+	std::vector<FdChannel *> channel_updates_;
+	
 	// Avoid notifying repeatedly when pushing tasks
 	std::atomic<bool> notified_;
 	
-	std::vector<Functor> *pending_functors_; // guard by mutex_
+	// Set by StopInLoop to leave the Run loop, io event thread only
+	bool quit_;
+	
+	// Cleared by Stop(timeout_ms): functors from other threads are dropped
+	std::atomic<bool> accepting_;
+	std::atomic<uint64_t> rejected_count_;
+	
+	// Drain state of Stop(timeout_ms), io event thread only
+	bool draining_;
+	int64_t drain_deadline_us_;
+	std::unique_ptr<EventWatcher> drain_timer_; // wakes the poll at the deadline
+	uint64_t dropped_output_bytes_;
+	FutureState<StopResult> *stop_state_;
+	
+	// Connected TcpConns, io event thread only
+	std::vector<TcpConn *> connections_;
 	
+	struct PendingTask {
+		Functor functor;
+		int64_t enqueue_us;
+	};
+	
+#ifdef ZRTC_EVLOOP_LOCKFREE_QUEUE
+	typedef MpscTaskQueue<PendingTask> PendingQueue;
+#else
+	typedef LockedTaskQueue<PendingTask> PendingQueue;
+#endif
+	
+	struct Lane {
+		// Pushed by any thread, popped by the io event thread only
+		PendingQueue queue;
+		std::atomic<int> depth;
+		std::atomic<uint64_t> executed;
+		std::atomic<int64_t> total_wait_us;
+		std::atomic<int64_t> max_wait_us;
+	};
+	
+	Lane lanes_[kTaskPriorityCount];
+	
+	// Sum of the lane depths
 	std::atomic<int> pending_functor_count_;
+	
+	std::atomic<int> connection_count_;
+	
+	int budget_max_count_;
+	int64_t budget_max_time_us_;
+	std::atomic<uint64_t> budget_exhausted_count_;
+	std::atomic<uint64_t> budget_deferred_count_;
+	
+	CpuAffinity affinity_;
+	
+	// io event thread only
+	std::vector<Functor> idle_functors_;
+	std::vector<Functor> end_of_iteration_functors_;
+	
+	// Busy-poll state, io event thread only
+	int64_t busy_poll_max_us_;
+	int64_t busy_poll_spin_us_;
+	int64_t busy_poll_idle_avg_us_;
+	
+	// NowMicros() of this iteration, 0 until read, io event thread only
+	int64_t now_us_;
+	
+	LoopStatsCollector stats_;
 };
 
 } // namespace evloop
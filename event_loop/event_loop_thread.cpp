@@ -0,0 +1,66 @@
+#include "zrtc/event_loop/event_loop_thread.h"
+
+#include <chrono>
+
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+
+namespace evloop {
+
+EventLoopThread::EventLoopThread(const std::string &name)
+	: name_(name)
+	, loop_(new EventLoop()) {
+}
+
+EventLoopThread::~EventLoopThread() {
+	Stop();
+}
+
+bool EventLoopThread::Start(bool wait_until_running) {
+	if (thread_.get()) {
+		return false;
+	}
+
+	thread_.reset(new std::thread(std::bind(&EventLoopThread::Run, this)));
+
+	if (wait_until_running) {
+		while (!loop_->IsRunning()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	return true;
+}
+
+void EventLoopThread::Stop() {
+	if (!thread_.get()) {
+		return;
+	}
+
+	// The loop may not be dispatching yet if Start() did not wait
+	while (!loop_->IsRunning() && !loop_->IsStopped()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	if (loop_->IsRunning()) {
+		loop_->Stop();
+	}
+
+	if (thread_->joinable()) {
+		thread_->join();
+	}
+
+	thread_.reset();
+}
+
+bool EventLoopThread::IsRunning() const {
+	return loop_->IsRunning();
+}
+
+void EventLoopThread::Run() {
+	LOG_T_F(LS_INFO) << "EventLoopThread " << name_ << " started.";
+	loop_->Run();
+	LOG_T_F(LS_INFO) << "EventLoopThread " << name_ << " stopped.";
+}
+
+} // namespace evloop
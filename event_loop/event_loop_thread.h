@@ -0,0 +1,54 @@
+/*
+ * File:   event_loop_thread.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 10:05 AM
+ */
+
+#ifndef ZRTC_EVENT_LOOP_THREAD_H
+#define ZRTC_EVENT_LOOP_THREAD_H
+
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace evloop {
+
+class EventLoop;
+
+// @brief: An EventLoop bound to its own std::thread for its whole life
+class EventLoopThread {
+public:
+	explicit EventLoopThread(const std::string &name = std::string());
+	~EventLoopThread();
+
+	// @brief: Start the thread and run the loop in it
+	// @param wait_until_running: block until the loop is dispatching events
+	bool Start(bool wait_until_running = true);
+
+	// @brief: Stop the loop and join the thread
+	void Stop();
+
+public:
+	EventLoop *loop() const {
+		return loop_.get();
+	}
+
+	const std::string &name() const {
+		return name_;
+	}
+
+	bool IsRunning() const;
+
+private:
+	void Run();
+
+private:
+	std::string name_;
+	std::unique_ptr<EventLoop> loop_;
+	std::unique_ptr<std::thread> thread_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_EVENT_LOOP_THREAD_H */
@@ -0,0 +1,113 @@
+#include "zrtc/event_loop/event_loop_thread_pool.h"
+
+#include <string>
+
+#include "zrtc/event_loop/cpu_affinity.h"
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/event_loop_thread.h"
+
+namespace evloop {
+
+namespace {
+	// Finalizer of splitmix64, spreads sequential connection ids
+	inline uint64_t MixHash(uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ull;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebull;
+		x ^= x >> 31;
+		return x;
+	}
+}
+
+EventLoopThreadPool::EventLoopThreadPool(uint32_t thread_num,
+										Placement placement)
+	: next_(0)
+	, placement_(placement) {
+	assert(thread_num > 0);
+
+	for (uint32_t i = 0; i < thread_num; ++i) {
+		threads_.emplace_back(new EventLoopThread("loop-" + std::to_string(i)));
+	}
+}
+
+EventLoopThreadPool::~EventLoopThreadPool() {
+	Stop();
+}
+
+void EventLoopThreadPool::SetOneLoopPerPhysicalCore() {
+	for (size_t i = 0; i < threads_.size(); ++i) {
+		threads_[i]->loop()->SetCpuAffinity(
+				CpuAffinity::PhysicalCore(static_cast<int>(i)));
+	}
+}
+
+bool EventLoopThreadPool::Start(bool wait_until_running) {
+	for (auto &t : threads_) {
+		if (!t->Start(wait_until_running)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void EventLoopThreadPool::Stop() {
+	for (auto &t : threads_) {
+		t->Stop();
+	}
+}
+
+EventLoop *EventLoopThreadPool::loop(uint32_t index) const {
+	assert(index < threads_.size());
+	return threads_[index]->loop();
+}
+
+EventLoop *EventLoopThreadPool::GetLoopForConnection(uint64_t conn_id) {
+	if (policy_) {
+		return policy_(this, conn_id);
+	}
+
+	switch (placement_) {
+		case kHash:
+			return GetLoopForHash(conn_id);
+		case kLeastLoaded:
+			return GetLeastLoadedLoop();
+		case kRoundRobin:
+		default:
+			return GetNextLoop();
+	}
+}
+
+EventLoop *EventLoopThreadPool::GetNextLoop() {
+	uint64_t next = next_.fetch_add(1, std::memory_order_relaxed);
+	return threads_[next % threads_.size()]->loop();
+}
+
+EventLoop *EventLoopThreadPool::GetLoopForHash(uint64_t hash) {
+	return threads_[MixHash(hash) % threads_.size()]->loop();
+}
+
+EventLoop *EventLoopThreadPool::GetLeastLoadedLoop() {
+	// The counters are read without synchronisation with the loops, so this
+	// is a best effort snapshot which is good enough for placement. Start
+	// from a rotating index so that ties do not all land on the first loop
+	size_t n = threads_.size();
+	size_t start = next_.fetch_add(1, std::memory_order_relaxed) % n;
+	EventLoop *best = nullptr;
+	int best_load = 0;
+
+	for (size_t i = 0; i < n; ++i) {
+		EventLoop *l = threads_[(start + i) % n]->loop();
+		int load = l->connection_count() + l->pending_functor_count();
+		if (best == nullptr || load < best_load) {
+			best = l;
+			best_load = load;
+		}
+	}
+
+	return best;
+}
+
+} // namespace evloop
@@ -0,0 +1,82 @@
+/*
+ * File:   event_loop_thread_pool.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 10:20 AM
+ */
+
+#ifndef ZRTC_EVENT_LOOP_THREAD_POOL_H
+#define ZRTC_EVENT_LOOP_THREAD_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace evloop {
+
+class EventLoop;
+class EventLoopThread;
+
+// @brief: A fixed set of EventLoops, each one running in its own thread.
+// Connections are spread over the loops so that thousands of them share a
+// fixed number of threads instead of owning one thread each.
+class EventLoopThreadPool {
+public:
+	enum Placement {
+		kRoundRobin = 0,
+		kHash = 1,        // hashed on TcpConn::id()
+		kLeastLoaded = 2, // fewest connections + pending functors
+	};
+
+	// @brief: A user defined placement, used instead of Placement when set
+	typedef std::function<EventLoop *(EventLoopThreadPool *pool,
+									uint64_t conn_id)> PlacementPolicy;
+
+public:
+	explicit EventLoopThreadPool(uint32_t thread_num,
+								Placement placement = kRoundRobin);
+	~EventLoopThreadPool();
+
+	// @brief: Pin loop i to physical core i (wrapping around) and let it
+	// allocate on that core's NUMA node
+	// @note: Call it before Start()
+	void SetOneLoopPerPhysicalCore();
+
+	bool Start(bool wait_until_running = true);
+	void Stop();
+
+	// @brief: Pick the loop for a new connection with the current policy
+	// @note: It is thread safe
+	EventLoop *GetLoopForConnection(uint64_t conn_id);
+
+	EventLoop *GetNextLoop();
+	EventLoop *GetLoopForHash(uint64_t hash);
+	EventLoop *GetLeastLoadedLoop();
+
+public:
+	void set_placement(Placement placement) {
+		placement_ = placement;
+	}
+
+	void SetPlacementPolicy(const PlacementPolicy &policy) {
+		policy_ = policy;
+	}
+
+	uint32_t thread_num() const {
+		return static_cast<uint32_t>(threads_.size());
+	}
+
+	EventLoop *loop(uint32_t index) const;
+
+private:
+	std::vector<std::unique_ptr<EventLoopThread> > threads_;
+	std::atomic<uint64_t> next_;
+	Placement placement_;
+	PlacementPolicy policy_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_EVENT_LOOP_THREAD_POOL_H */
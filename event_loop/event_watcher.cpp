@@ -1,5 +1,10 @@
 #include "zrtc/event_loop/event_watcher.h"
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
 #include "zrtc/event_loop/libevent.h"
 
 #include "zrtc/event_loop/event_loop.h"
@@ -8,20 +13,11 @@
 
 namespace evloop {
 
-EventWatcher::EventWatcher(struct ::event_base* evbase, const Handler& handler)
-	: evbase_(evbase)
-	, attached_(false)
-	, handler_(handler) {
-	event_ = new event();
-	memset(event_, 0, sizeof(struct event));
-}
-
 EventWatcher::EventWatcher(struct ::event_base* evbase, Handler&& handler)
 	: evbase_(evbase)
 	, attached_(false)
 	, handler_(std::move(handler)) {
-	event_ = new event();
-	memset(event_, 0, sizeof(struct event));
+	event_ = LoopAllocator::NewEvent();
 }
 
 EventWatcher::~EventWatcher() {
@@ -47,12 +43,16 @@ void EventWatcher::Close() {
 }
 
 bool EventWatcher::Watch(int timeout_ms) {
+	return Watch(std::chrono::milliseconds(timeout_ms));
+}
+
+bool EventWatcher::Watch(std::chrono::microseconds timeout) {
 	struct timeval tv;
 	struct timeval *timeoutval = nullptr;
 	
-	if (timeout_ms > 0) {
-		tv.tv_sec = timeout_ms / 1000;
-		tv.tv_usec = 0;
+	if (timeout.count() > 0) {
+		tv.tv_sec = timeout.count() / 1000000;
+		tv.tv_usec = timeout.count() % 1000000;
 		timeoutval = &tv;
 	}
 	
@@ -84,7 +84,7 @@ void EventWatcher::FreeEvent() {
 			attached_ = false;
 		}
 		
-		delete event_;
+		LoopAllocator::DeleteEvent(event_);
 		event_ = nullptr;
 	}
 }
@@ -97,19 +97,14 @@ void EventWatcher::Cancel() {
 	}
 }
 
-void EventWatcher::SetCancelCallback(const Handler& cb) {
-	cancel_callback_ = cb;
+void EventWatcher::SetCancelCallback(Handler cb) {
+	cancel_callback_ = std::move(cb);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// PipeEventWatcher ///////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-PipeEventWatcher::PipeEventWatcher(EventLoop* loop, const Handler& handler)
-	: EventWatcher(loop->event_base(), handler) {
-	memset(pipe_, 0, sizeof(pipe_[0] * 2));
-}
-
 PipeEventWatcher::PipeEventWatcher(EventLoop* loop, Handler&& handler)
 	: EventWatcher(loop->event_base(), std::move(handler)) {
 	memset(pipe_, 0, sizeof(pipe_[0] * 2));
@@ -172,23 +167,84 @@ void PipeEventWatcher::Notify() {
 	}
 }
 
+#ifdef __linux__
+////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////// EventFdWatcher /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+EventFdWatcher::EventFdWatcher(EventLoop* loop, Handler&& handler)
+	: EventWatcher(loop->event_base(), std::move(handler))
+	, fd_(-1) {
+}
+
+EventFdWatcher::~EventFdWatcher() {
+	Close();
+}
+
+bool EventFdWatcher::DoInit() {
+	assert(fd_ == -1);
+	
+	fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd_ < 0) {
+		int err = errno;
+		LOG_T_F(LS_ERROR) << "create eventfd ERROR errno=" << err << " " << strerror(err);
+		return false;
+	}
+	
+	event_set(event_, fd_, EV_READ | EV_PERSIST,
+			&EventFdWatcher::HandlerFn, this);
+	
+	return true;
+}
+
+void EventFdWatcher::DoClose() {
+	if (fd_ >= 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+
+void EventFdWatcher::HandlerFn(int fd, short which, void* v) {
+	EventFdWatcher *e = (EventFdWatcher *)v;
+	uint64_t count = 0;
+	
+	if (::read(e->fd_, &count, sizeof(count)) == sizeof(count)) {
+		e->handler_();
+	}
+}
+
+bool EventFdWatcher::AsyncWait() {
+	return Watch(0);
+}
+
+void EventFdWatcher::Notify() {
+	uint64_t one = 1;
+	if (::write(fd_, &one, sizeof(one)) < 0) {
+		// EAGAIN means the counter is saturated, the fd is readable anyway
+		return;
+	}
+}
+#endif // __linux__
+
 ////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// TimerEventWatcher //////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
 TimerEventWatcher::TimerEventWatcher(EventLoop* loop,
-									const Handler& handler,
+									Handler&& handler,
 									int timeout)
-	: EventWatcher(loop->event_base(), handler)
-	, timeout_ms_(timeout) {
-
+	: EventWatcher(loop->event_base(), std::move(handler))
+	, loop_(loop)
+	, timeout_(std::chrono::milliseconds(timeout)) {
+	
 }
 
 TimerEventWatcher::TimerEventWatcher(EventLoop* loop,
 									Handler&& handler,
-									int timeout)
+									std::chrono::microseconds timeout)
 	: EventWatcher(loop->event_base(), std::move(handler))
-	, timeout_ms_(timeout) {
+	, loop_(loop)
+	, timeout_(timeout) {
 	
 }
 
@@ -203,12 +259,113 @@ bool TimerEventWatcher::DoInit() {
 
 void TimerEventWatcher::HandlerFn(int fd, short which, void* v) {
 	TimerEventWatcher *t = (TimerEventWatcher *)v;
+	CallbackStatsScope scope(t->loop_->stats_collector(),
+							LoopStatsCollector::kTimerCallback,
+							reinterpret_cast<intptr_t>(t),
+							t->handler_.invoke_address());
 	t->handler_();
 }
 
 bool TimerEventWatcher::AsyncWait() {
-	Watch(timeout_ms_);
+	return Watch(timeout_);
+}
+
+#ifdef __linux__
+////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////// TimerFdWatcher /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+TimerFdWatcher::TimerFdWatcher(EventLoop* loop,
+							Handler&& handler,
+							std::chrono::microseconds timeout,
+							bool periodic)
+	: EventWatcher(loop->event_base(), std::move(handler))
+	, loop_(loop)
+	, fd_(-1)
+	, timeout_(timeout)
+	, periodic_(periodic)
+	, armed_(false)
+	, expirations_(0) {
+}
+
+TimerFdWatcher::~TimerFdWatcher() {
+	Close();
+}
+
+bool TimerFdWatcher::DoInit() {
+	assert(fd_ == -1);
+	
+	fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd_ < 0) {
+		int err = errno;
+		LOG_T_F(LS_ERROR) << "create timerfd ERROR errno=" << err << " " << strerror(err);
+		return false;
+	}
+	
+	event_set(event_, fd_, EV_READ | EV_PERSIST,
+			&TimerFdWatcher::HandlerFn, this);
+	
+	return true;
+}
+
+void TimerFdWatcher::DoClose() {
+	if (fd_ >= 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+
+void TimerFdWatcher::HandlerFn(int fd, short which, void* v) {
+	TimerFdWatcher *t = (TimerFdWatcher *)v;
+	uint64_t count = 0;
+	
+	if (::read(t->fd_, &count, sizeof(count)) != sizeof(count)) {
+		return;
+	}
+	
+	if (!t->periodic_) {
+		t->armed_ = false;
+	}
+	
+	t->expirations_ = count;
+	CallbackStatsScope scope(t->loop_->stats_collector(),
+							LoopStatsCollector::kTimerCallback,
+							reinterpret_cast<intptr_t>(t),
+							t->handler_.invoke_address());
+	t->handler_();
+}
+
+bool TimerFdWatcher::AsyncWait() {
+	if (periodic_ && armed_) {
+		return true;
+	}
+	
+	// The read event stays registered, re-arming is a timerfd_settime only
+	if (!attached_ && !Watch(0)) {
+		return false;
+	}
+	
+	// A zero it_value disarms the timer
+	int64_t us = timeout_.count() > 0 ? timeout_.count() : 1;
+	
+	struct itimerspec its;
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = us / 1000000;
+	its.it_value.tv_nsec = (us % 1000000) * 1000;
+	if (periodic_) {
+		its.it_interval = its.it_value;
+	}
+	
+	if (::timerfd_settime(fd_, 0, &its, nullptr) != 0) {
+		int err = errno;
+		LOG_T_F(LS_ERROR) << "timerfd_settime ERROR errno=" << err << " " << strerror(err);
+		return false;
+	}
+	
+	armed_ = true;
+	return true;
 }
+#endif // __linux__
 
 } // namespace evloop
 
@@ -8,8 +8,12 @@
 #ifndef ZRTC_EVENT_WATCHER_H
 #define ZRTC_EVENT_WATCHER_H
 
+#include <chrono>
 #include <functional>
 
+#include "zrtc/event_loop/loop_allocator.h"
+#include "zrtc/event_loop/task.h"
+
 struct event_base;
 struct event;
 
@@ -17,9 +21,9 @@ namespace evloop {
 
 class EventLoop;
 
-class EventWatcher {
+class EventWatcher: public LoopAllocated {
 public:
-	typedef std::function<void()> Handler;
+	typedef Task Handler;
 	
 public:
 //	EventWatcher();
@@ -30,7 +34,7 @@ public:
 	// @note: It must be called in the event thread
 	void Cancel();
 	
-	void SetCancelCallback(const Handler &cb);
+	void SetCancelCallback(Handler cb);
 	
 	void ClearHandler() {
 		handler_ = Handler();
@@ -45,8 +49,11 @@ protected:
 	// or 0 to wait forever
 	bool Watch(int timeout);
 	
+	// @brief: Same as Watch(int) with microseconds
+	// @note: libevent sleeps in whole milliseconds, rounded up
+	bool Watch(std::chrono::microseconds timeout);
+	
 protected:
-	EventWatcher(struct ::event_base *evbase, const Handler &handler);
 	EventWatcher(struct ::event_base *evbase, Handler &&handler);
 	
 	void Close();
@@ -65,7 +72,6 @@ protected:
 
 class PipeEventWatcher: public EventWatcher {
 public:
-	PipeEventWatcher(EventLoop *loop, const Handler &handler);
 	PipeEventWatcher(EventLoop *loop, Handler &&handler);
 	
 	virtual ~PipeEventWatcher();
@@ -87,23 +93,100 @@ private:
 	int pipe_[2];
 };
 
+#ifdef __linux__
+// @brief: Same job as PipeEventWatcher on top of eventfd(2): one fd,
+// Notify() adds 1 to an 8-byte counter and one read() resets it for the
+// whole batch of notifications
+class EventFdWatcher: public EventWatcher {
+public:
+	EventFdWatcher(EventLoop *loop, Handler &&handler);
+	
+	virtual ~EventFdWatcher();
+	
+	virtual bool AsyncWait() override;
+	virtual void Notify() override;
+	
+	int fd() const {
+		return fd_;
+	}
+	
+private:
+	virtual bool DoInit() override;
+	virtual void DoClose() override;
+	
+	static void HandlerFn(int fd, short which, void *v);
+	
+private:
+	int fd_;
+};
+#endif // __linux__
+
 class TimerEventWatcher: public EventWatcher {
 public:
-	TimerEventWatcher(EventLoop *loop, const Handler &handler, int timeout);
 	TimerEventWatcher(EventLoop *loop, Handler &&handler, int timeout);
 	
+	TimerEventWatcher(EventLoop *loop, Handler &&handler,
+					std::chrono::microseconds timeout);
+	
 	virtual ~TimerEventWatcher();
 	
 	virtual bool AsyncWait() override;
 	
+	// @brief: The timeout of the next AsyncWait()
+	void set_timeout(std::chrono::microseconds timeout) {
+		timeout_ = timeout;
+	}
+	
+private:
+	virtual bool DoInit() override;
+	
+	static void HandlerFn(int fd, short which, void *v);
+	
+private:
+	EventLoop *loop_;
+	std::chrono::microseconds timeout_;
+};
+
+#ifdef __linux__
+// @brief: A timer on timerfd_create(CLOCK_MONOTONIC): the kernel wakes the
+// loop at the microsecond rather than at libevent's next millisecond.
+// A periodic timer is armed once with it_interval, so its period does not
+// drift with the latency of the callbacks
+class TimerFdWatcher: public EventWatcher {
+public:
+	TimerFdWatcher(EventLoop *loop, Handler &&handler,
+				std::chrono::microseconds timeout, bool periodic);
+	
+	virtual ~TimerFdWatcher();
+	
+	// @brief: Arm the timer, a no-op for a periodic timer already armed
+	virtual bool AsyncWait() override;
+	
+	// @brief: The expirations of the last wake-up, more than 1 when the
+	// loop was late by a period or more
+	uint64_t expirations() const {
+		return expirations_;
+	}
+	
+	int fd() const {
+		return fd_;
+	}
+	
 private:
 	virtual bool DoInit() override;
+	virtual void DoClose() override;
 	
 	static void HandlerFn(int fd, short which, void *v);
 	
 private:
-	int timeout_ms_;
+	EventLoop *loop_;
+	int fd_;
+	std::chrono::microseconds timeout_;
+	bool periodic_;
+	bool armed_;
+	uint64_t expirations_;
 };
+#endif // __linux__
 	
 } // namespace evloop
 
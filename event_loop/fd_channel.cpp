@@ -4,6 +4,8 @@
 #include "zrtc/event_loop/event_loop.h"
 #include "zrtc/event_loop/event_common.h"
 #include "zrtc/event_loop/event_sockets.h"
+#include "zrtc/event_loop/loop_allocator.h"
+#include "zrtc/event_loop/poller.h"
 
 namespace evloop {
 
@@ -13,25 +15,54 @@ FdChannel::FdChannel(evloop::EventLoop* loop,
 		bool w)
 	: loop_(loop)
 	, attached_(false)
+	, edge_triggered_(false)
 	, event_(nullptr)
+	, write_event_(nullptr)
+	, applied_flags_(kNone)
+	, update_pending_(false)
 	, fd_(fd) {
 	flags_ = (r ? kReadable : 0) | (w ? kWritable : 0);
-	event_ = new event();
-	memset(event_, 0, sizeof(struct event));
+	
+	// The native backends keep the registration in their own set
+	if (loop_->poller() == nullptr) {
+		event_ = LoopAllocator::NewEvent();
+		write_event_ = LoopAllocator::NewEvent();
+	}
 }
 
 FdChannel::~FdChannel() {
-
+	if (update_pending_) {
+		loop_->CancelChannelUpdate(this);
+	}
 }
 
 void FdChannel::Close() {
+	if (update_pending_) {
+		loop_->CancelChannelUpdate(this);
+		update_pending_ = false;
+	}
+	
+	if (loop_->poller() && attached_) {
+		loop_->poller()->Remove(this);
+		attached_ = false;
+	}
+	
 	if (event_) {
-		if (attached_) {
+		if (applied_flags_ & kReadable) {
 			evloop::EventDel(event_);
 		}
 		
-		delete event_;
+		if (applied_flags_ & kWritable) {
+			evloop::EventDel(write_event_);
+		}
+		
+		attached_ = false;
+		applied_flags_ = kNone;
+		
+		LoopAllocator::DeleteEvent(event_);
 		event_ = nullptr;
+		LoopAllocator::DeleteEvent(write_event_);
+		write_event_ = nullptr;
 	}
 	
 	read_fn_ = ReadEventCallback();
@@ -42,21 +73,53 @@ void FdChannel::AttachToLoop() {
 	//LOG_T_F(LS_VERBOSE) << "fd=" << fd_ << " attach to event loop";
 	assert(!IsNoneEvent());
 	assert(loop_->IsInLoopThread());
-	// detach firstly, avoid multiplying calling this
-	if (attached_) {
-		DetachFromLoop();
+	
+	if (loop_->poller()) {
+		if (loop_->poller()->Update(this, flags_, edge_triggered_, attached_)) {
+			attached_ = true;
+			applied_flags_ = flags_;
+		}
+		
+		return;
+	}
+	
+	// Only the directions that changed: with one event each, a flip is a
+	// single event_add or event_del rather than a del/add of both
+	bool ok = SyncEvent(event_, kReadable);
+	ok = SyncEvent(write_event_, kWritable) && ok;
+	attached_ = applied_flags_ != kNone;
+	if (!ok) {
+		//LOG_T_F(LS_ERROR) << "event_add failed. fd=" << fd_;
+		return;
+	}
+}
+
+bool FdChannel::SyncEvent(struct event *ev, int flag) {
+	bool want = (flags_ & flag) != 0;
+	bool have = (applied_flags_ & flag) != 0;
+	if (want == have) {
+		return true;
 	}
 	
-	event_set(event_, fd_, flags_ | EV_PERSIST,
+	if (have) {
+		if (evloop::EventDel(ev) != 0) {
+			return false;
+		}
+		
+		applied_flags_ &= ~flag;
+		return true;
+	}
+	
+	event_set(ev, fd_, (flag == kReadable ? EV_READ : EV_WRITE) | EV_PERSIST,
 			&FdChannel::HandleEvent, this);
-	event_base_set(loop_->event_base(), event_);
+	event_base_set(loop_->event_base(), ev);
 	
-	if (evloop::EventAdd(event_, nullptr) != 0) {
-		//LOG_T_F(LS_ERROR) << "event_add failed. fd=" << this->event_->ev_fd << " event_=" << event_;
-		return;
+	if (evloop::EventAdd(ev, nullptr) != 0) {
+		return false;
 	}
 	
-	attached_ = true;
+	applied_flags_ |= flag;
+	return true;
 }
 
 void FdChannel::EnableReadEvent() {
@@ -110,21 +173,46 @@ void FdChannel::DetachFromLoop() {
 	assert(loop_->IsInLoopThread());
 	assert(attached_);
 	
-	if (evloop::EventDel(event_) != 0) {
+	if (loop_->poller()) {
+		loop_->poller()->Remove(this);
+		attached_ = false;
+		applied_flags_ = kNone;
+		return;
+	}
+	
+	if ((applied_flags_ & kReadable) && evloop::EventDel(event_) != 0) {
 		//LOG_T_F(LS_ERROR) << "DetachFromLoop this=" << this << "fd=" << fd_ << " with event " << EventsToString() << " detach from event loop failed";
 		return;
 	}
-	else {
-		//LOG_T_F(LS_VERBOSE) << "fd=" << fd_ << " detach from event loop";
-		attached_ = false;
+	
+	applied_flags_ &= ~kReadable;
+	if ((applied_flags_ & kWritable) && evloop::EventDel(write_event_) != 0) {
+		return;
 	}
+	
+	//LOG_T_F(LS_VERBOSE) << "fd=" << fd_ << " detach from event loop";
+	attached_ = false;
+	applied_flags_ = kNone;
 }
 
 void FdChannel::UpdateFlag() {
+	assert(loop_->IsInLoopThread());
+	
+	if (!update_pending_) {
+		update_pending_ = true;
+		loop_->QueueChannelUpdate(this);
+	}
+}
+
+void FdChannel::ApplyUpdate() {
+	update_pending_ = false;
+	
 	if (IsNoneEvent()) {
-		DetachFromLoop();
+		if (attached_) {
+			DetachFromLoop();
+		}
 	}
-	else {
+	else if (!attached_ || flags_ != applied_flags_) {
 		AttachToLoop();
 	}
 }
@@ -150,6 +238,12 @@ std::string FdChannel::EventsToString() const {
 void FdChannel::HandleEvent(int fd, short which) {
 	assert(fd_ == fd);
 	
+	// The poller may still have a direction disabled in this iteration
+	which &= flags_;
+	
+	CallbackStatsScope scope(loop_->stats_collector(),
+							LoopStatsCollector::kFdCallback, fd);
+	
 	if ((which & kReadable) && read_fn_) {
 		read_fn_();
 	}
@@ -11,6 +11,9 @@
 #include <functional>
 #include <string>
 
+#include "zrtc/event_loop/loop_allocator.h"
+#include "zrtc/event_loop/task.h"
+
 struct event;
 struct event_base;
 
@@ -19,7 +22,7 @@ namespace evloop {
 class EventWatcher;
 class EventLoop;
 
-class FdChannel {
+class FdChannel: public LoopAllocated {
 public:
 	enum EventType {
 		kNone = 0x00,
@@ -27,8 +30,8 @@ public:
 		kWritable = 0x04,
 	};
 	
-	typedef std::function<void()> EventCallback;
-	typedef std::function<void()> ReadEventCallback;
+	typedef Task EventCallback;
+	typedef Task ReadEventCallback;
 	
 public:
 	FdChannel(EventLoop *loop, int fd,
@@ -45,6 +48,13 @@ public:
 		return attached_;
 	}
 	
+	// @brief: Register the fd edge-triggered, the callbacks must then read
+	// or write until EAGAIN. Only the epoll backend honours it
+	// @note: Call it before the first Enable*Event()
+	void SetEdgeTriggered(bool on) {
+		edge_triggered_ = on;
+	}
+	
 public:
 	bool IsReadable() const {
 		return (flags_ & kReadable) != 0;
@@ -58,6 +68,9 @@ public:
 		return flags_ == kNone;
 	}
 	
+	// @note: The change reaches the poller before the loop polls again,
+	// so the flips of one iteration cost a single update, or none when
+	// they cancel out. Callbacks of a disabled direction are not run
 	void EnableReadEvent();
 	void EnableWriteEvent();
 	void DisableReadEvent();
@@ -72,19 +85,33 @@ public:
 	std::string EventsToString() const;
 	
 public:
-	void SetReadCallback(const ReadEventCallback &cb) {
-		read_fn_ = cb;
+	void SetReadCallback(ReadEventCallback cb) {
+		read_fn_ = std::move(cb);
 	}
 	
-	void SetWriteCallback(const EventCallback &cb) {
-		write_fn_ = cb;
+	void SetWriteCallback(EventCallback cb) {
+		write_fn_ = std::move(cb);
 	}
 	
 private:
+	friend class EventLoop;
+	friend class EpollPoller;
+	friend class IoUringPoller;
+	
 	void HandleEvent(int fd, short which);
 	static void HandleEvent(int fd, short which, void *v);
 	
+	// @brief: Queue the interest change in the loop
 	void UpdateFlag();
+	
+	// @brief: Bring the registration in line with flags_, called by the
+	// loop before it polls
+	void ApplyUpdate();
+	
+	// @brief: libevent backend, add or delete ev so that the flag
+	// direction matches flags_
+	bool SyncEvent(struct event *ev, int flag);
+	
 	void DetachFromLoop();
 	
 private:
@@ -93,10 +120,16 @@ private:
 	
 	EventLoop * loop_;
 	bool attached_;
+	bool edge_triggered_;
 	
 	struct event * event_;
+	struct event * write_event_;
 	int flags_;
 	
+	// What the poller was last told, and whether the loop holds an update
+	int applied_flags_;
+	bool update_pending_;
+	
 	int fd_;
 };
 
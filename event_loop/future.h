@@ -0,0 +1,270 @@
+/*
+ * File:   future.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 6:00 PM
+ */
+
+#ifndef ZRTC_FUTURE_H
+#define ZRTC_FUTURE_H
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace evloop {
+
+// @brief: Result slot shared by a Future and the functor computing it
+template <typename R>
+class FutureState {
+public:
+	FutureState(): refs_(2), ready_(false) {}
+
+	void AddRef() {
+		refs_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Release() {
+		if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			delete this;
+		}
+	}
+
+	bool ready() const {
+		return ready_.load(std::memory_order_acquire);
+	}
+
+	void Wait() {
+		if (ready()) {
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		cond_.wait(lock, [this]() { return ready(); });
+	}
+
+	// @return: false on timeout
+	bool WaitFor(int64_t timeout_ms) {
+		if (ready()) {
+			return true;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		return cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+							[this]() { return ready(); });
+	}
+
+	template <typename F>
+	void Run(F &f) {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+		try {
+			Store(f, std::is_void<R>());
+		}
+		catch (...) {
+			error_ = std::current_exception();
+		}
+#else
+		Store(f, std::is_void<R>());
+#endif
+		SetReady();
+	}
+
+	// @brief: The functor was destroyed without running, e.g. the loop
+	// stopped before reaching it
+	void Abandon() {
+		error_ = std::make_exception_ptr(
+				std::future_error(std::future_errc::broken_promise));
+		SetReady();
+	}
+
+	// @note: Only once, after Wait()
+	R Take() {
+		assert(ready());
+		if (error_) {
+			std::rethrow_exception(error_);
+		}
+
+		return Get(std::is_void<R>());
+	}
+
+protected:
+	virtual ~FutureState() {
+		if (has_value_) {
+			reinterpret_cast<Value *>(&value_)->~Value();
+		}
+	}
+
+private:
+	// void results are stored as nothing
+	typedef typename std::conditional<std::is_void<R>::value,
+									char, R>::type Value;
+
+	template <typename F>
+	void Store(F &f, std::false_type /*void*/) {
+		::new (static_cast<void *>(&value_)) Value(f());
+		has_value_ = true;
+	}
+
+	template <typename F>
+	void Store(F &f, std::true_type /*void*/) {
+		f();
+	}
+
+	Value Get(std::false_type /*void*/) {
+		return std::move(*reinterpret_cast<Value *>(&value_));
+	}
+
+	void Get(std::true_type /*void*/) {}
+
+	void SetReady() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		ready_.store(true, std::memory_order_release);
+		cond_.notify_all();
+	}
+
+private:
+	std::atomic<int> refs_;
+	std::atomic<bool> ready_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+
+	std::exception_ptr error_;
+	bool has_value_ = false;
+	typename std::aligned_storage<sizeof(Value), alignof(Value)>::type value_;
+};
+
+// @brief: The callable and the result slot in one allocation
+template <typename R, typename F>
+class SubmitState: public FutureState<R> {
+public:
+	explicit SubmitState(F &&f): f_(std::move(f)) {}
+
+	void Run() {
+		FutureState<R>::Run(f_);
+	}
+
+private:
+	F f_;
+};
+
+// @brief: The loop side of a SubmitState, stored in the Task. It fits the
+// Task inline storage, so the SubmitState is the only allocation
+template <typename R, typename F>
+class SubmitFunctor {
+public:
+	explicit SubmitFunctor(SubmitState<R, F> *s): state_(s) {}
+
+	SubmitFunctor(SubmitFunctor &&other) noexcept: state_(other.state_) {
+		other.state_ = nullptr;
+	}
+
+	~SubmitFunctor() {
+		if (state_) {
+			state_->Abandon();
+			state_->Release();
+		}
+	}
+
+	void operator()() {
+		SubmitState<R, F> *s = state_;
+		state_ = nullptr;
+		s->Run();
+		s->Release();
+	}
+
+private:
+	SubmitFunctor(const SubmitFunctor &);
+	SubmitFunctor &operator=(const SubmitFunctor &);
+
+	SubmitState<R, F> *state_;
+};
+
+// @brief: Result of EventLoop::Submit. Move-only, get() blocks until the
+// loop ran the functor and rethrows what it threw
+// @note: Do not block on it in the io event thread, unless the functor
+// was submitted from that thread (it has then already run)
+template <typename R>
+class Future {
+public:
+	Future(): state_(nullptr) {}
+
+	explicit Future(FutureState<R> *s): state_(s) {}
+
+	Future(Future &&other) noexcept: state_(other.state_) {
+		other.state_ = nullptr;
+	}
+
+	Future &operator=(Future &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			state_ = other.state_;
+			other.state_ = nullptr;
+		}
+
+		return *this;
+	}
+
+	~Future() {
+		Reset();
+	}
+
+	bool valid() const {
+		return state_ != nullptr;
+	}
+
+	bool ready() const {
+		assert(state_);
+		return state_->ready();
+	}
+
+	void wait() const {
+		assert(state_);
+		state_->Wait();
+	}
+
+	// @return: true if the result is ready
+	bool wait_for(int64_t timeout_ms) const {
+		assert(state_);
+		return state_->WaitFor(timeout_ms);
+	}
+
+	// @note: Only once, the future is empty afterwards
+	R get() {
+		assert(state_);
+		state_->Wait();
+		Holder h(state_);
+		state_ = nullptr;
+		return h.state->Take();
+	}
+
+private:
+	Future(const Future &);
+	Future &operator=(const Future &);
+
+	// Releases the state also when Take() throws
+	struct Holder {
+		explicit Holder(FutureState<R> *s): state(s) {}
+		~Holder() { state->Release(); }
+		FutureState<R> *state;
+	};
+
+	void Reset() {
+		if (state_) {
+			state_->Release();
+			state_ = nullptr;
+		}
+	}
+
+	FutureState<R> *state_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_FUTURE_H */
@@ -1,30 +1,51 @@
 #include "zrtc/event_loop/invoke_timer.h"
 
+#include <functional>
 #include <memory>
+#include <random>
+#include <thread>
 
 #include "zrtc/event_loop/event_loop.h"
 #include "zrtc/event_loop/event_watcher.h"
 
+namespace {
+    // Jitter and phase, drawn on the io event thread
+    uint32_t Random() {
+        thread_local std::minstd_rand rng(static_cast<uint32_t>(
+            evloop::MonotonicMicros()
+            ^ std::hash<std::thread::id>()(std::this_thread::get_id())));
+        return rng();
+    }
+}
+
 namespace evloop {
 
-InvokeTimer::InvokeTimer(EventLoop* evloop, int timeout_ms, const Functor& f, bool periodic)
-    : loop_(evloop), timeout_ms_(timeout_ms), functor_(f), periodic_(periodic) {
+InvokeTimer::InvokeTimer(EventLoop* evloop, std::chrono::microseconds timeout,
+                         Functor&& f, bool periodic, bool high_resolution)
+    : loop_(evloop), timeout_(timeout), functor_(std::move(f)), periodic_(periodic)
+    , high_resolution_(high_resolution), next_deadline_ms_(0), missed_ticks_(0) {
     LOG_T_F(LS_INFO) << "loop=" << loop_;
 }
 
-InvokeTimer::InvokeTimer(EventLoop* evloop, int timeout_ms, Functor&& f, bool periodic)
-    : loop_(evloop), timeout_ms_(timeout_ms), functor_(std::move(f)), periodic_(periodic) {
-    LOG_T_F(LS_INFO) << "loop=" << loop_;
+InvokeTimerPtr InvokeTimer::Create(EventLoop* evloop, int timeout_ms, Functor&& f, bool periodic) {
+    InvokeTimerPtr it(new InvokeTimer(evloop, std::chrono::milliseconds(timeout_ms),
+                                      std::move(f), periodic, false));
+    it->self_ = it;
+    return it;
 }
 
-InvokeTimerPtr InvokeTimer::Create(EventLoop* evloop, int timeout_ms, const Functor& f, bool periodic) {
-    InvokeTimerPtr it(new InvokeTimer(evloop, timeout_ms, f, periodic));
+InvokeTimerPtr InvokeTimer::Create(EventLoop* evloop, std::chrono::microseconds timeout,
+                                   Functor&& f, bool periodic) {
+    InvokeTimerPtr it(new InvokeTimer(evloop, timeout, std::move(f), periodic, true));
     it->self_ = it;
     return it;
 }
 
-InvokeTimerPtr InvokeTimer::Create(EventLoop* evloop, int timeout_ms, Functor&& f, bool periodic) {
-    InvokeTimerPtr it(new InvokeTimer(evloop, timeout_ms, std::move(f), periodic));
+InvokeTimerPtr InvokeTimer::Create(EventLoop* evloop, int period_ms,
+                                   Functor&& f, const PeriodicOptions& options) {
+    InvokeTimerPtr it(new InvokeTimer(evloop, std::chrono::milliseconds(period_ms),
+                                      std::move(f), true, false));
+    it->options_ = options;
     it->self_ = it;
     return it;
 }
@@ -37,14 +58,32 @@ void InvokeTimer::Start() {
     LOG_T_F(LS_INFO) << "loop=" << loop_ << " refcount=" << self_.use_count();
 
     auto f = [this]() {
+        // The timerfd of a high resolution timer keeps its own period
+        int64_t delay_ms = high_resolution_ ? 0 : NextDelayMs(true);
+
+        TimingWheel *wheel = loop_->timing_wheel();
+        if (wheel && !high_resolution_) {
+            node_.fn = &InvokeTimer::WheelHandlerFn;
+            node_.arg = this;
+            wheel->Add(&node_, delay_ms);
+            return;
+        }
+
 		{
 			auto time_weak = std::weak_ptr<InvokeTimer>(shared_from_this());
-			timer_.reset(new TimerEventWatcher(loop_, [time_weak]() {
+			auto fn = [time_weak]() {
 				auto time_ptr = time_weak.lock();
 				if (time_ptr) {
 					time_ptr->OnTimerTriggered();
 				}
-			}, timeout_ms_));
+			};
+#ifdef __linux__
+			if (high_resolution_) {
+				timer_.reset(new TimerFdWatcher(loop_, std::move(fn), timeout_, periodic_));
+			} else
+#endif
+			timer_.reset(new TimerEventWatcher(loop_, std::move(fn),
+					high_resolution_ ? timeout_ : std::chrono::milliseconds(delay_ms > 0 ? delay_ms : 1)));
 		}
         
 		{
@@ -57,10 +96,11 @@ void InvokeTimer::Start() {
 			});
 		}
 		
-		timer_->Init();
-        timer_->AsyncWait();
+		if (!timer_->Init() || !timer_->AsyncWait()) {
+			LOG_T_F(LS_ERROR) << "timer=" << timer_.get() << " loop=" << loop_ << " failed to start";
+		}
         
-        LOG_T_F(LS_VERBOSE) << "timer=" << timer_.get() << " loop=" << loop_ << " refcount=" << self_.use_count() << " periodic=" << periodic_ << " timeout(ms)=" << timeout_ms_;
+        LOG_T_F(LS_VERBOSE) << "timer=" << timer_.get() << " loop=" << loop_ << " refcount=" << self_.use_count() << " periodic=" << periodic_ << " timeout(us)=" << timeout_.count();
     };
     loop_->RunInLoop(std::move(f));
 }
@@ -71,8 +111,15 @@ void InvokeTimer::Cancel() {
         auto time_ptr = time_weak.lock();
         if (time_ptr && time_ptr->timer_) {
             time_ptr->timer_->Cancel();
+        } else if (time_ptr && time_ptr->self_ && time_ptr->node_.fn) {
+            // On the wheel. From its own callback the node is unscheduled
+            // already, OnCanceled() still stops a periodic timer
+            time_ptr->loop_->timing_wheel()->Remove(&time_ptr->node_);
+            time_ptr->OnCanceled();
         }
     };
+    // The lane of Start(): from another thread a Cancel() must not run
+    // before the timer is armed
     loop_->RunInLoop(std::move(f));
 }
 
@@ -81,13 +128,67 @@ void InvokeTimer::OnTimerTriggered() {
     functor_();
 
     if (periodic_) {
-        timer_->AsyncWait();
+        if (high_resolution_) {
+            timer_->AsyncWait();
+        } else if (timer_) {
+            // Not high resolution: always a TimerEventWatcher. A zero
+            // timeout would add the event with no timeval at all, never
+            // to fire again
+            int64_t delay_ms = NextDelayMs(false);
+            static_cast<TimerEventWatcher *>(timer_.get())->set_timeout(
+                    std::chrono::milliseconds(delay_ms > 0 ? delay_ms : 1));
+            timer_->AsyncWait();
+        } else {
+            loop_->timing_wheel()->Add(&node_, NextDelayMs(false));
+        }
     } else {
         timer_.reset();
         self_.reset();
     }
 }
 
+int64_t InvokeTimer::NextDelayMs(bool first) {
+    int64_t period = std::chrono::duration_cast<std::chrono::milliseconds>(timeout_).count();
+
+    // The time the loop woke up at: libevent and the wheel count the
+    // delay from it as well
+    int64_t now = loop_->Now();
+
+    if (first) {
+        int64_t phase = period;
+        if (options_.phase_ms == PeriodicOptions::kRandomPhase && period > 0) {
+            phase = 1 + Random() % period;
+        } else if (options_.phase_ms > 0) {
+            phase = options_.phase_ms;
+        }
+        next_deadline_ms_ = now + phase;
+    } else if (options_.fixed_rate && period > 0) {
+        next_deadline_ms_ += period;
+        if (next_deadline_ms_ < now) {
+            int64_t missed = (now - next_deadline_ms_) / period + 1;
+            next_deadline_ms_ += missed * period;
+            missed_ticks_ += missed;
+        }
+    } else {
+        next_deadline_ms_ = now + period;
+    }
+
+    int64_t delay_ms = next_deadline_ms_ - now;
+    if (options_.jitter_ms > 0) {
+        delay_ms += Random() % (options_.jitter_ms + 1);
+    }
+
+    return delay_ms;
+}
+
+void InvokeTimer::WheelHandlerFn(void *v) {
+    InvokeTimer *t = (InvokeTimer *)v;
+
+    // A Cancel() from the functor drops self_
+    InvokeTimerPtr hold(t->shared_from_this());
+    t->OnTimerTriggered();
+}
+
 void InvokeTimer::OnCanceled() {
     LOG_T_F(LS_INFO) << "loop=" << loop_ << " use_count=" << self_.use_count();
     periodic_ = false;
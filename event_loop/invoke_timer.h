@@ -14,8 +14,13 @@
 #ifndef ZRTC_INVOKE_TIMER_H
 #define ZRTC_INVOKE_TIMER_H
 
+#include <chrono>
+
 #include "zrtc/event_loop/libevent.h"
 #include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/loop_allocator.h"
+#include "zrtc/event_loop/task.h"
+#include "zrtc/event_loop/timing_wheel.h"
 
 namespace evloop {
 	
@@ -25,9 +30,30 @@ class InvokeTimer;
 
 typedef std::shared_ptr<InvokeTimer> InvokeTimerPtr;
 
-class InvokeTimer : public std::enable_shared_from_this<InvokeTimer> {
+// @brief: How a periodic InvokeTimer places its ticks
+struct PeriodicOptions {
+    // phase_ms for a random first tick within the first period
+    static const int kRandomPhase = -1;
+
+    PeriodicOptions() : fixed_rate(false), jitter_ms(0), phase_ms(0) {}
+
+    // Next deadline = previous deadline + period, so the callbacks do not
+    // make the period drift. Ticks the loop was too late for are skipped
+    // and counted in InvokeTimer::missed_ticks()
+    bool fixed_rate;
+
+    // Delay each tick by a random 0..jitter_ms, off the nominal deadline
+    int jitter_ms;
+
+    // First tick after phase_ms instead of one period, or kRandomPhase.
+    // With either, timers started together do not fire in lockstep
+    int phase_ms;
+};
+
+class InvokeTimer : public LoopAllocated,
+                    public std::enable_shared_from_this<InvokeTimer> {
 public:
-    typedef std::function<void()> Functor;
+    typedef Task Functor;
 
     // @brief Create a timer. When the timer is timeout, the functor f will
     //  be invoked automatically.
@@ -40,12 +66,22 @@ public:
     //  and can cancel this timer at any time.
     static InvokeTimerPtr Create(EventLoop* evloop,
                                  int timeout_ms,
-                                 const Functor& f,
+                                 Functor&& f,
                                  bool periodic);
+
+    // @brief Create a high resolution timer: a timerfd(CLOCK_MONOTONIC)
+    //  on Linux, a libevent timer with the microseconds elsewhere. It
+    //  bypasses the TimingWheel, which counts in milliseconds.
     static InvokeTimerPtr Create(EventLoop* evloop,
-                                 int timeout_ms,
+                                 std::chrono::microseconds timeout,
                                  Functor&& f,
                                  bool periodic);
+
+    // @brief Create a periodic timer scheduled as options says
+    static InvokeTimerPtr Create(EventLoop* evloop,
+                                 int period_ms,
+                                 Functor&& f,
+                                 const PeriodicOptions& options);
     ~InvokeTimer();
 
     // It is thread safe.
@@ -55,22 +91,39 @@ public:
     // Cancel the timer and the cancel_callback_ will be invoked.
     void Cancel();
 
-    void set_cancel_callback(const Functor& fn) {
-        cancel_callback_ = fn;
+    void set_cancel_callback(Functor fn) {
+        cancel_callback_ = std::move(fn);
+    }
+
+    // @brief Ticks skipped by a fixed rate timer because the loop was
+    //  late by one period or more
+    uint64_t missed_ticks() const {
+        return missed_ticks_;
     }
 private:
-    InvokeTimer(EventLoop* evloop, int timeout_ms, const Functor& f, bool periodic);
-    InvokeTimer(EventLoop* evloop, int timeout_ms, Functor&& f, bool periodic);
+    InvokeTimer(EventLoop* evloop, std::chrono::microseconds timeout,
+                Functor&& f, bool periodic, bool high_resolution);
     void OnTimerTriggered();
     void OnCanceled();
 
+    // @brief Move next_deadline_ms_ to the next tick and return the delay
+    //  to it, jitter included
+    int64_t NextDelayMs(bool first);
+
+    static void WheelHandlerFn(void *v);
+
 private:
     EventLoop* loop_;
-    int timeout_ms_;
+    std::chrono::microseconds timeout_;
     Functor functor_;
     Functor cancel_callback_;
     std::unique_ptr<EventWatcher> timer_;
+    TimingWheel::Node node_; // Instead of timer_ when the loop has a wheel
     bool periodic_;
+    bool high_resolution_;
+    PeriodicOptions options_;
+    int64_t next_deadline_ms_; // Nominal deadline of the next tick, loop clock
+    uint64_t missed_ticks_;
     std::shared_ptr<InvokeTimer> self_; // Hold myself
 };
 
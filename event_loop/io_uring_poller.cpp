@@ -0,0 +1,461 @@
+#include "zrtc/event_loop/io_uring_poller.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "zrtc/event_loop/libevent.h"
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/fd_channel.h"
+
+namespace evloop {
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+namespace {
+	const unsigned kSqEntries = 4096;
+	const unsigned kCqEntries = 16384;
+
+	// user_data of a POLL_REMOVE, its completion is ignored
+	const uint64_t kCancelUserData = 0;
+
+	// A poll that failed for want of resources, not because of the fd
+	bool IsRetriablePollError(int err) {
+		return err == EINTR || err == EAGAIN || err == ENOMEM
+			|| err == ENOBUFS || err == ECANCELED;
+	}
+
+	uint64_t MakeUserData(int fd, uint32_t gen) {
+		return ((uint64_t)gen << 32) | (uint32_t)fd;
+	}
+
+	int Setup(unsigned entries, struct io_uring_params *p) {
+		return (int)syscall(__NR_io_uring_setup, entries, p);
+	}
+
+	int Enter(int fd, unsigned to_submit) {
+		return (int)syscall(__NR_io_uring_enter, fd, to_submit, 0, 0, nullptr, 0);
+	}
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+	: loop_(loop)
+	, ring_fd_(-1)
+	, event_(nullptr)
+	, sq_ptr_(MAP_FAILED)
+	, sq_size_(0)
+	, cq_ptr_(MAP_FAILED)
+	, cq_size_(0)
+	, sqes_((struct io_uring_sqe *)MAP_FAILED)
+	, sqes_size_(0)
+	, sq_head_(nullptr)
+	, sq_tail_(nullptr)
+	, sq_array_(nullptr)
+	, sq_mask_(0)
+	, sq_entries_(0)
+	, sq_local_tail_(0)
+	, to_submit_(0)
+	, cq_head_(nullptr)
+	, cq_tail_(nullptr)
+	, cqes_(nullptr)
+	, cq_mask_(0)
+	, enter_count_(0)
+	, sqe_count_(0) {
+}
+
+IoUringPoller::~IoUringPoller() {
+	if (event_) {
+		EventDel(event_);
+		delete event_;
+		event_ = nullptr;
+	}
+
+	if (sqes_ != MAP_FAILED) {
+		munmap(sqes_, sqes_size_);
+	}
+
+	if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) {
+		munmap(cq_ptr_, cq_size_);
+	}
+
+	if (sq_ptr_ != MAP_FAILED) {
+		munmap(sq_ptr_, sq_size_);
+	}
+
+	// Closing the ring cancels the polls still in flight
+	if (ring_fd_ >= 0) {
+		close(ring_fd_);
+		ring_fd_ = -1;
+	}
+}
+
+bool IoUringPoller::Init() {
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = kCqEntries;
+
+	ring_fd_ = Setup(kSqEntries, &p);
+	if (ring_fd_ < 0) {
+		LOG_T_F(LS_WARNING) << "io_uring_setup failed, errno=" << errno;
+		return false;
+	}
+
+	// Without NODROP a burst of completions would be lost, not delayed
+	if (!(p.features & IORING_FEAT_NODROP)) {
+		LOG_T_F(LS_WARNING) << "io_uring without IORING_FEAT_NODROP, not used.";
+		return false;
+	}
+
+	sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_mmap && cq_size_ > sq_size_) {
+		sq_size_ = cq_size_;
+	}
+
+	sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+	if (sq_ptr_ == MAP_FAILED) {
+		LOG_T_F(LS_ERROR) << "mmap of the submission ring failed, errno=" << errno;
+		return false;
+	}
+
+	if (single_mmap) {
+		cq_ptr_ = sq_ptr_;
+	}
+	else {
+		cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+		if (cq_ptr_ == MAP_FAILED) {
+			LOG_T_F(LS_ERROR) << "mmap of the completion ring failed, errno=" << errno;
+			return false;
+		}
+	}
+
+	sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+	sqes_ = (struct io_uring_sqe *)mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+							MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+	if (sqes_ == MAP_FAILED) {
+		LOG_T_F(LS_ERROR) << "mmap of the submission entries failed, errno=" << errno;
+		return false;
+	}
+
+	char *sq = (char *)sq_ptr_;
+	sq_head_ = (unsigned *)(sq + p.sq_off.head);
+	sq_tail_ = (unsigned *)(sq + p.sq_off.tail);
+	sq_array_ = (unsigned *)(sq + p.sq_off.array);
+	sq_mask_ = *(unsigned *)(sq + p.sq_off.ring_mask);
+	sq_entries_ = p.sq_entries;
+	sq_local_tail_ = *sq_tail_;
+
+	char *cq = (char *)cq_ptr_;
+	cq_head_ = (unsigned *)(cq + p.cq_off.head);
+	cq_tail_ = (unsigned *)(cq + p.cq_off.tail);
+	cqes_ = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	cq_mask_ = *(unsigned *)(cq + p.cq_off.ring_mask);
+
+	// The ring fd is readable while completions wait in it
+	event_ = new event();
+	memset(event_, 0, sizeof(struct event));
+	event_set(event_, ring_fd_, EV_READ | EV_PERSIST,
+			&IoUringPoller::HandlerFn, this);
+	event_base_set(loop_->event_base(), event_);
+	if (EventAdd(event_, nullptr) != 0) {
+		LOG_T_F(LS_ERROR) << "event_add failed for the io_uring fd.";
+		return false;
+	}
+
+	return true;
+}
+
+bool IoUringPoller::Update(FdChannel *c, int flags, bool edge_triggered,
+						bool registered) {
+	Entry *e = GetEntry(c->fd());
+	e->channel = c;
+	e->flags = flags;
+
+	uint32_t mask = 0;
+	if (flags & FdChannel::kReadable) {
+		mask |= POLLIN;
+	}
+
+	if (flags & FdChannel::kWritable) {
+		mask |= POLLOUT;
+	}
+
+	// The poll in flight already watches the same directions
+	if (e->armed == mask) {
+		return true;
+	}
+
+	if (e->armed != 0) {
+		Cancel(c->fd(), e);
+	}
+
+	Arm(c->fd(), e);
+	return true;
+}
+
+void IoUringPoller::Remove(FdChannel *c) {
+	if (c->fd() < 0 || (size_t)c->fd() >= entries_.size()) {
+		return;
+	}
+
+	Entry *e = &entries_[c->fd()];
+	if (e->channel != c) {
+		return;
+	}
+
+	// Its completion, in flight or already posted, is stale from now on
+	if (e->armed != 0) {
+		Cancel(c->fd(), e);
+	}
+	else if (++e->gen == 0) {
+		e->gen = 1;
+	}
+
+	e->channel = nullptr;
+	e->flags = 0;
+}
+
+void IoUringPoller::Flush() {
+	if (to_submit_ == 0) {
+		return;
+	}
+
+	__atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+	++enter_count_;
+	int n = Enter(ring_fd_, to_submit_);
+	if (n < 0) {
+		// EAGAIN or EBUSY: the entries stay in the ring for the next call
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+			LOG_T_F(LS_ERROR) << "io_uring_enter failed, errno=" << errno;
+		}
+
+		return;
+	}
+
+	to_submit_ -= std::min<unsigned>(n, to_submit_);
+}
+
+IoUringPoller::Entry *IoUringPoller::GetEntry(int fd) {
+	if ((size_t)fd >= entries_.size()) {
+		Entry e;
+		e.channel = nullptr;
+		e.flags = 0;
+		e.armed = 0;
+		e.gen = 1;
+		entries_.resize(fd + 1 + fd / 2, e);
+	}
+
+	return &entries_[fd];
+}
+
+struct io_uring_sqe *IoUringPoller::GetSqe() {
+	unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+	if (sq_local_tail_ - head >= sq_entries_) {
+		// More changes in one iteration than the ring holds
+		Flush();
+		head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+		if (sq_local_tail_ - head >= sq_entries_) {
+			return nullptr;
+		}
+	}
+
+	unsigned index = sq_local_tail_ & sq_mask_;
+	struct io_uring_sqe *sqe = &sqes_[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sq_array_[index] = index;
+
+	++sq_local_tail_;
+	++to_submit_;
+	++sqe_count_;
+	return sqe;
+}
+
+void IoUringPoller::Arm(int fd, Entry *e) {
+	uint32_t mask = 0;
+	if (e->flags & FdChannel::kReadable) {
+		mask |= POLLIN;
+	}
+
+	if (e->flags & FdChannel::kWritable) {
+		mask |= POLLOUT;
+	}
+
+	if (mask == 0) {
+		return;
+	}
+
+	struct io_uring_sqe *sqe = GetSqe();
+	if (sqe == nullptr) {
+		LOG_T_F(LS_ERROR) << "io_uring submission ring full, fd=" << fd << " not polled";
+		return;
+	}
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll_events = (__u16)mask;
+	sqe->user_data = MakeUserData(fd, e->gen);
+	e->armed = mask;
+}
+
+void IoUringPoller::Cancel(int fd, Entry *e) {
+	struct io_uring_sqe *sqe = GetSqe();
+	if (sqe != nullptr) {
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = MakeUserData(fd, e->gen);
+		sqe->user_data = kCancelUserData;
+	}
+
+	e->armed = 0;
+	if (++e->gen == 0) {
+		e->gen = 1;
+	}
+}
+
+void IoUringPoller::Reap() {
+	// What was posted before the first callback, later completions keep
+	// the ring fd readable for the next pass
+	unsigned head = *cq_head_;
+	unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		struct io_uring_cqe *cqe = &cqes_[head & cq_mask_];
+		uint64_t user_data = cqe->user_data;
+		int32_t res = cqe->res;
+
+		++head;
+		__atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+		Dispatch(user_data, res);
+	}
+}
+
+void IoUringPoller::Dispatch(uint64_t user_data, int32_t res) {
+	if (user_data == kCancelUserData) {
+		return;
+	}
+
+	int fd = (int)(uint32_t)user_data;
+	uint32_t gen = (uint32_t)(user_data >> 32);
+	if ((size_t)fd >= entries_.size()) {
+		return;
+	}
+
+	Entry *e = &entries_[fd];
+	if (e->gen != gen || e->channel == nullptr) {
+		return;
+	}
+
+	e->armed = 0;
+	FdChannel *c = e->channel;
+
+	if (res < 0 && IsRetriablePollError(-res)) {
+		// Nothing happened on the fd, poll it again
+		LOG_T_F(LS_WARNING) << "io_uring poll failed, fd=" << fd << " res=" << res << ", re-armed";
+		e->flags = c->flags_;
+		Arm(fd, e);
+		return;
+	}
+
+	if (res < 0) {
+		// The owner sees the error on its next read or write and closes
+		LOG_T_F(LS_ERROR) << "io_uring poll failed, fd=" << fd << " res=" << res << ", not polled any more";
+	}
+
+	// As libevent does: an error or a hang-up wakes both directions
+	short which = 0;
+	if (res < 0 || (res & (POLLHUP | POLLERR))) {
+		which = FdChannel::kReadable | FdChannel::kWritable;
+	}
+	else {
+		if (res & POLLIN) {
+			which |= FdChannel::kReadable;
+		}
+
+		if (res & POLLOUT) {
+			which |= FdChannel::kWritable;
+		}
+	}
+
+	which &= c->flags_;
+	if (which != 0) {
+		c->HandleEvent(fd, which);
+	}
+
+	// Re-arm, unless the callback removed, re-registered or replaced the
+	// channel. A poll that failed for good is not retried. The interest is taken from the
+	// channel, so that a change it queued in the callback costs no cancel
+	e = &entries_[fd];
+	if (res >= 0 && e->channel == c && e->gen == gen && e->armed == 0) {
+		e->flags = c->flags_;
+		Arm(fd, e);
+	}
+}
+
+void IoUringPoller::HandlerFn(int fd, short which, void *v) {
+	IoUringPoller *p = (IoUringPoller *)v;
+	p->Reap();
+}
+
+#else // __linux__ && __NR_io_uring_setup
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+	: loop_(loop)
+	, ring_fd_(-1)
+	, event_(nullptr)
+	, sq_ptr_(nullptr)
+	, sq_size_(0)
+	, cq_ptr_(nullptr)
+	, cq_size_(0)
+	, sqes_(nullptr)
+	, sqes_size_(0)
+	, sq_head_(nullptr)
+	, sq_tail_(nullptr)
+	, sq_array_(nullptr)
+	, sq_mask_(0)
+	, sq_entries_(0)
+	, sq_local_tail_(0)
+	, to_submit_(0)
+	, cq_head_(nullptr)
+	, cq_tail_(nullptr)
+	, cqes_(nullptr)
+	, cq_mask_(0)
+	, enter_count_(0)
+	, sqe_count_(0) {
+}
+
+IoUringPoller::~IoUringPoller() {
+}
+
+bool IoUringPoller::Init() {
+	return false;
+}
+
+bool IoUringPoller::Update(FdChannel *, int, bool, bool) {
+	return false;
+}
+
+void IoUringPoller::Remove(FdChannel *) {
+}
+
+void IoUringPoller::Flush() {
+}
+
+void IoUringPoller::HandlerFn(int, short, void *) {
+}
+
+#endif // __linux__ && __NR_io_uring_setup
+
+} // namespace evloop
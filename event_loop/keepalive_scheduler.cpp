@@ -0,0 +1,133 @@
+#include "zrtc/event_loop/keepalive_scheduler.h"
+
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/tcp_conn.h"
+
+namespace evloop {
+
+KeepaliveScheduler::KeepaliveScheduler(EventLoop *loop,
+									int interval_ms,
+									int slots)
+	: loop_(loop)
+	, interval_ms_(interval_ms)
+	, slots_(slots > 0 ? slots : 1)
+	, next_slot_(0)
+	, size_(0)
+	, ticking_(false)
+	, probe_count_(0)
+	, skip_count_(0) {
+}
+
+KeepaliveScheduler::~KeepaliveScheduler() {
+	for (size_t s = 0; s < slots_.size(); ++s) {
+		for (size_t i = 0; i < slots_[s].size(); ++i) {
+			slots_[s][i]->keepalive_slot_ = -1;
+		}
+	}
+
+	if (timer_) {
+		timer_->Cancel();
+		timer_.reset();
+	}
+}
+
+void KeepaliveScheduler::Add(TcpConn *c) {
+	assert(loop_->IsInLoopThread());
+	if (c->keepalive_slot_ >= 0) {
+		return;
+	}
+
+	size_t best = 0;
+	for (size_t s = 1; s < slots_.size(); ++s) {
+		if (slots_[s].size() < slots_[best].size()) {
+			best = s;
+		}
+	}
+
+	c->keepalive_slot_ = static_cast<int>(best);
+	c->keepalive_index_ = slots_[best].size();
+	c->last_ping_ms_ = loop_->Now();
+	slots_[best].push_back(c);
+	++size_;
+
+	if (!timer_) {
+		// Fixed rate: a slot is visited once per interval, not a bit later
+		// every time
+		PeriodicOptions options;
+		options.fixed_rate = true;
+
+		int tick_ms = interval_ms_ / static_cast<int>(slots_.size());
+		timer_ = loop_->RunEvery(tick_ms > 0 ? tick_ms : 1,
+								std::bind(&KeepaliveScheduler::Tick, this),
+								options);
+	}
+}
+
+void KeepaliveScheduler::Remove(TcpConn *c) {
+	assert(loop_->IsInLoopThread());
+	if (c->keepalive_slot_ < 0) {
+		return;
+	}
+
+	std::vector<TcpConn *> &slot = slots_[c->keepalive_slot_];
+	TcpConn *last = slot.back();
+	slot[c->keepalive_index_] = last;
+	last->keepalive_index_ = c->keepalive_index_;
+	slot.pop_back();
+	c->keepalive_slot_ = -1;
+	--size_;
+
+	if (size_ == 0) {
+		if (ticking_) {
+			// Not from the callback of the timer being cancelled
+			loop_->QueueInLoop(std::bind(&KeepaliveScheduler::StopIfIdle, this));
+		} else {
+			StopIfIdle();
+		}
+	}
+}
+
+void KeepaliveScheduler::StopIfIdle() {
+	if (size_ == 0 && timer_) {
+		timer_->Cancel();
+		timer_.reset();
+	}
+}
+
+void KeepaliveScheduler::Tick() {
+	std::vector<TcpConn *> &slot = slots_[next_slot_];
+	next_slot_ = (next_slot_ + 1) % slots_.size();
+
+	int64_t now = loop_->Now();
+	int64_t max_skip_ms = static_cast<int64_t>(kMaxSkippedProbes) * interval_ms_;
+
+	ticking_ = true;
+
+	// Backwards: a failed ping closes its connection, which moves the last
+	// one, visited already, into its place
+	for (size_t i = slot.size(); i-- > 0; ) {
+		if (i >= slot.size()) {
+			continue;
+		}
+
+		TcpConn *c = slot[i];
+		if (now - c->last_send_ms_ < interval_ms_
+			&& now - c->last_ping_ms_ < max_skip_ms) {
+			++skip_count_;
+			continue;
+		}
+
+		c->last_ping_ms_ = now;
+		++probe_count_;
+
+		// Ping() may close the connection and drop its last reference
+		TcpConnPtr conn(c->shared_from_this());
+		c->Ping();
+	}
+
+	ticking_ = false;
+}
+
+} // namespace evloop
+
@@ -0,0 +1,90 @@
+/*
+ * File:   keepalive_scheduler.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 11:55 PM
+ */
+
+#ifndef ZRTC_KEEPALIVE_SCHEDULER_H
+#define ZRTC_KEEPALIVE_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "zrtc/event_loop/invoke_timer.h"
+
+namespace evloop {
+
+class EventLoop;
+class TcpConn;
+
+// @brief: The ping of every TcpConn of one EventLoop, on a single timer
+// in place of one RunEvery per connection.
+//
+// The interval is cut into slots and each connection joins the least
+// loaded one, so the probes are spread evenly instead of bursting. A tick
+// walks one slot and pings the connections that sent nothing during the
+// last interval. A busy connection is still pinged every
+// kMaxSkippedProbes intervals to keep its rtt() fresh.
+// @note: io event thread only. The timer runs while connections are
+// registered
+class KeepaliveScheduler {
+public:
+	static const int kDefaultIntervalMs = 1000;
+	static const int kDefaultSlots = 20;
+	static const int kMaxSkippedProbes = 5;
+
+public:
+	explicit KeepaliveScheduler(EventLoop *loop,
+								int interval_ms = kDefaultIntervalMs,
+								int slots = kDefaultSlots);
+	~KeepaliveScheduler();
+
+	// @brief: Start pinging c, from the next visit of its slot on
+	void Add(TcpConn *c);
+
+	// @brief: Stop pinging c, a no-op if it is not registered
+	void Remove(TcpConn *c);
+
+	size_t size() const {
+		return size_;
+	}
+
+	int interval_ms() const {
+		return interval_ms_;
+	}
+
+	// @brief: Pings sent, and probes skipped because data went out
+	uint64_t probe_count() const {
+		return probe_count_;
+	}
+
+	uint64_t skip_count() const {
+		return skip_count_;
+	}
+
+private:
+	void Tick();
+	void StopIfIdle();
+
+private:
+	EventLoop *loop_;
+	int interval_ms_;
+
+	// The connections of each slot, TcpConn keeps its own position
+	std::vector<std::vector<TcpConn *>> slots_;
+	size_t next_slot_;
+	size_t size_;
+	bool ticking_;
+
+	InvokeTimerPtr timer_;
+
+	uint64_t probe_count_;
+	uint64_t skip_count_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_KEEPALIVE_SCHEDULER_H */
+
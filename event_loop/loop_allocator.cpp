@@ -0,0 +1,152 @@
+#include "zrtc/event_loop/loop_allocator.h"
+
+#include <cstring>
+#include <new>
+
+#include "zrtc/event_loop/libevent.h"
+
+namespace evloop {
+
+namespace {
+	// The allocator of the loop running on this thread
+	thread_local LoopAllocator *current = nullptr;
+}
+
+LoopAllocator::Scope::Scope(LoopAllocator *a)
+	: saved_(current) {
+	current = a;
+}
+
+LoopAllocator::Scope::~Scope() {
+	current = saved_;
+}
+
+LoopAllocator::LoopAllocator()
+	: cursor_(nullptr)
+	, end_(nullptr)
+	, remote_(nullptr)
+	, refs_(1) {
+	memset(free_, 0, sizeof(free_));
+}
+
+LoopAllocator::~LoopAllocator() {
+	for (size_t i = 0; i < slabs_.size(); ++i) {
+		::operator delete(slabs_[i]);
+	}
+}
+
+void LoopAllocator::Release() {
+	if (current == this) {
+		current = nullptr;
+	}
+
+	Unref();
+}
+
+void LoopAllocator::Unref() {
+	if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete this;
+	}
+}
+
+void *LoopAllocator::Allocate(size_t size) {
+	size_t total = size + sizeof(Header);
+	LoopAllocator *a = current;
+
+	if (a == nullptr || total > kMaxBlockSize) {
+		Header *h = static_cast<Header *>(::operator new(total));
+		h->allocator = nullptr;
+		return h + 1;
+	}
+
+	return a->AllocateLocal((total - 1) / kClassSize);
+}
+
+void LoopAllocator::Free(void *p) {
+	if (p == nullptr) {
+		return;
+	}
+
+	Header *h = static_cast<Header *>(p) - 1;
+	LoopAllocator *a = h->allocator;
+	if (a == nullptr) {
+		::operator delete(h);
+		return;
+	}
+
+	if (a == current) {
+		a->FreeLocal(h);
+	}
+	else {
+		a->FreeRemote(h);
+	}
+
+	a->Unref();
+}
+
+struct event *LoopAllocator::NewEvent() {
+	void *p = Allocate(sizeof(struct event));
+	memset(p, 0, sizeof(struct event));
+	return static_cast<struct event *>(p);
+}
+
+void LoopAllocator::DeleteEvent(struct event *ev) {
+	Free(ev);
+}
+
+void *LoopAllocator::AllocateLocal(size_t size_class) {
+	refs_.fetch_add(1, std::memory_order_relaxed);
+
+	if (free_[size_class] == nullptr && remote_.load(std::memory_order_relaxed)) {
+		DrainRemote();
+	}
+
+	FreeBlock *b = free_[size_class];
+	if (b != nullptr) {
+		free_[size_class] = b->next;
+		return b;
+	}
+
+	size_t block = (size_class + 1) * kClassSize;
+	if (cursor_ == nullptr || static_cast<size_t>(end_ - cursor_) < block) {
+		// The tail of the old slab is left unused
+		char *slab = static_cast<char *>(::operator new(kSlabSize));
+		slabs_.push_back(slab);
+		cursor_ = slab;
+		end_ = slab + kSlabSize;
+	}
+
+	Header *h = reinterpret_cast<Header *>(cursor_);
+	cursor_ += block;
+	h->allocator = this;
+	h->size_class = static_cast<uint32_t>(size_class);
+	return h + 1;
+}
+
+void LoopAllocator::FreeLocal(Header *h) {
+	FreeBlock *b = reinterpret_cast<FreeBlock *>(h + 1);
+	b->next = free_[h->size_class];
+	free_[h->size_class] = b;
+}
+
+void LoopAllocator::FreeRemote(Header *h) {
+	FreeBlock *b = reinterpret_cast<FreeBlock *>(h + 1);
+	b->next = remote_.load(std::memory_order_relaxed);
+	while (!remote_.compare_exchange_weak(b->next, b,
+										std::memory_order_release,
+										std::memory_order_relaxed)) {
+	}
+}
+
+void LoopAllocator::DrainRemote() {
+	// Only the loop pops, and all at once: no ABA
+	FreeBlock *b = remote_.exchange(nullptr, std::memory_order_acquire);
+	while (b != nullptr) {
+		FreeBlock *next = b->next;
+		FreeLocal(reinterpret_cast<Header *>(b) - 1);
+		b = next;
+	}
+}
+
+} // namespace evloop
+
@@ -0,0 +1,127 @@
+/*
+ * File:   loop_allocator.h
+ * Author: lap11894
+ *
+ * Created on October 19, 2026, 1:05 AM
+ */
+
+#ifndef ZRTC_LOOP_ALLOCATOR_H
+#define ZRTC_LOOP_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct event;
+
+namespace evloop {
+
+// @brief: Slab allocator of one EventLoop, for the small objects created
+// and destroyed with every connection and timer: struct event, FdChannel,
+// the watchers, InvokeTimer, Connector, DNSResolver.
+//
+// Blocks come in size classes of 32 bytes up to kMaxBlockSize, carved out
+// of 64KB slabs and recycled through one free list per class, so they
+// stay packed together and the global allocator is left alone once the
+// loop has warmed up.
+//
+// Allocate() serves from the allocator of the loop running on the calling
+// thread, and from the global heap on any other thread. Every block
+// remembers where it came from: Free() from another thread pushes it on
+// a lock-free list that the loop takes back on its next allocation.
+// @note: The allocator lives until its loop is gone and its last block
+// freed
+class LoopAllocator {
+public:
+	static const size_t kClassSize = 32;
+	static const size_t kMaxBlockSize = 512;
+	static const size_t kSlabSize = 64 * 1024;
+
+	// @brief: Make a the allocator of the calling thread while in scope,
+	// for EventLoop::Run()
+	class Scope {
+	public:
+		explicit Scope(LoopAllocator *a);
+		~Scope();
+
+	private:
+		Scope(const Scope &);
+		Scope &operator=(const Scope &);
+
+		LoopAllocator *saved_;
+	};
+
+public:
+	LoopAllocator();
+
+	// @brief: Drop the loop's reference, the memory goes with the last block
+	void Release();
+
+	static void *Allocate(size_t size);
+	static void Free(void *p);
+
+	// @brief: A zeroed struct event
+	static struct event *NewEvent();
+	static void DeleteEvent(struct event *ev);
+
+	// @brief: Bytes held in slabs
+	size_t slab_bytes() const {
+		return slabs_.size() * kSlabSize;
+	}
+
+private:
+	~LoopAllocator();
+	LoopAllocator(const LoopAllocator &);
+	LoopAllocator &operator=(const LoopAllocator &);
+
+	// In front of every block, 16 bytes to keep the payload aligned
+	struct Header {
+		LoopAllocator *allocator; // null for the global heap
+		uint32_t size_class;
+		uint32_t reserved;
+	};
+
+	// Laid over the payload of a free block
+	struct FreeBlock {
+		FreeBlock *next;
+	};
+
+	static const size_t kClassCount = kMaxBlockSize / kClassSize;
+
+	void *AllocateLocal(size_t size_class);
+	void FreeLocal(Header *h);
+	void FreeRemote(Header *h);
+	void DrainRemote();
+	void Unref();
+
+private:
+	FreeBlock *free_[kClassCount];
+
+	// Bump pointer in the newest slab
+	char *cursor_;
+	char *end_;
+	std::vector<char *> slabs_;
+
+	// Freed by other threads
+	std::atomic<FreeBlock *> remote_;
+
+	// The loop's reference plus one per block out
+	std::atomic<int64_t> refs_;
+};
+
+// @brief: Base of the classes whose objects come from the LoopAllocator
+struct LoopAllocated {
+	static void *operator new(size_t size) {
+		return LoopAllocator::Allocate(size);
+	}
+
+	static void operator delete(void *p) {
+		LoopAllocator::Free(p);
+	}
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_LOOP_ALLOCATOR_H */
+
@@ -0,0 +1,245 @@
+/*
+ * File:   loop_channel.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 7:30 PM
+ */
+
+#ifndef ZRTC_LOOP_CHANNEL_H
+#define ZRTC_LOOP_CHANNEL_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/event_watcher.h"
+
+namespace evloop {
+
+// @brief: Bounded single-producer / single-consumer channel from one
+// EventLoop to another, for pipeline stages (parse -> route -> send) on
+// different cores. Messages go through a ring buffer without locks or
+// allocations, and the consumer loop is woken once per batch through its
+// own eventfd instead of the functor queue.
+//
+// A full ring is the backpressure: TryPush() fails and the writable
+// callback runs in the producer loop once the consumer made room.
+//
+// @note: Push from the producer loop thread only. Destroy the channel in
+// the consumer loop thread, or after the consumer loop stopped, but not
+// from the writable callback. A writable callback still queued in the
+// producer loop then does not run.
+template <typename T>
+class LoopChannel {
+public:
+	// @brief: Called in the consumer loop for each message
+	typedef std::function<void(T &)> MessageHandler;
+
+	// @brief: Called in the producer loop when a full ring has room again
+	typedef std::function<void()> WritableCallback;
+
+public:
+	// @param capacity: rounded up to a power of two
+	LoopChannel(EventLoop *producer,
+				EventLoop *consumer,
+				size_t capacity,
+				const MessageHandler &handler)
+		: producer_(producer)
+		, consumer_(consumer)
+		, handler_(handler)
+		, tail_(0)
+		, cached_head_(0)
+		, head_(0)
+		, cached_tail_(0)
+		, notified_(false)
+		, producer_blocked_(false)
+		, token_(std::make_shared<Token>()) {
+		token_->channel = this;
+
+		capacity_ = 1;
+		while (capacity_ < capacity) {
+			capacity_ <<= 1;
+		}
+		mask_ = capacity_ - 1;
+		slots_.reset(new Slot[capacity_]);
+
+		InitWatcher();
+	}
+
+	~LoopChannel() {
+		{
+			// Waits for a writable callback running in the producer loop
+			std::lock_guard<std::mutex> lock(token_->mutex);
+			token_->channel = nullptr;
+		}
+
+		watcher_.reset();
+
+		uint64_t tail = tail_.load(std::memory_order_acquire);
+		for (uint64_t i = head_.load(std::memory_order_relaxed); i != tail; ++i) {
+			At(i)->~T();
+		}
+	}
+
+	void SetWritableCallback(const WritableCallback &cb) {
+		writable_fn_ = cb;
+	}
+
+	// @return: false if the ring is full, the message is left untouched
+	// and the writable callback will run once there is room
+	bool TryPush(T &&v) {
+		assert(producer_->IsInLoopThread());
+
+		uint64_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - cached_head_ == capacity_) {
+			cached_head_ = head_.load(std::memory_order_acquire);
+
+			if (tail - cached_head_ == capacity_) {
+				// Ask for a writable callback, then look again: the
+				// consumer may have made room before it saw the flag
+				producer_blocked_.store(true);
+				cached_head_ = head_.load();
+				if (tail - cached_head_ == capacity_) {
+					return false;
+				}
+
+				producer_blocked_.store(false);
+			}
+		}
+
+		::new (static_cast<void *>(At(tail))) T(std::move(v));
+		tail_.store(tail + 1, std::memory_order_release);
+
+		// One wakeup per batch: only the first push after the consumer
+		// drained the ring notifies it
+		if (!notified_.exchange(true)) {
+			watcher_->Notify();
+		}
+
+		return true;
+	}
+
+	// @brief: Messages in the ring, approximate from other threads
+	size_t size() const {
+		return static_cast<size_t>(tail_.load(std::memory_order_acquire)
+								- head_.load(std::memory_order_acquire));
+	}
+
+	size_t capacity() const {
+		return capacity_;
+	}
+
+private:
+	typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+	T *At(uint64_t index) {
+		return reinterpret_cast<T *>(&slots_[index & mask_]);
+	}
+
+	void InitWatcher() {
+#ifdef __linux__
+		watcher_.reset(new EventFdWatcher(consumer_,
+						std::bind(&LoopChannel::Drain, this)));
+		if (!watcher_->Init()) {
+			LOG_T_F(LS_WARNING) << "EventFdWatcher init failed, fall back to PipeEventWatcher.";
+			watcher_.reset();
+		}
+#endif
+
+		if (!watcher_) {
+			watcher_.reset(new PipeEventWatcher(consumer_,
+							std::bind(&LoopChannel::Drain, this)));
+			if (!watcher_->Init()) {
+				LOG_T_F(LS_ERROR) << "PipeEventWatcher init failed.";
+			}
+		}
+
+		std::shared_ptr<Token> token(token_);
+		consumer_->RunInLoop([token]() {
+			std::lock_guard<std::mutex> lock(token->mutex);
+			if (token->channel) {
+				token->channel->watcher_->AsyncWait();
+			}
+		});
+	}
+
+	void Drain() {
+		assert(consumer_->IsInLoopThread());
+
+		// Clear the flag before reading tail_: a push from now on notifies
+		// again. Both sides use an RMW on notified_, which orders it with
+		// the tail_ store of the producer
+		notified_.exchange(false);
+
+		// Take what is there now, later pushes come with a new wakeup
+		uint64_t head = head_.load(std::memory_order_relaxed);
+		cached_tail_ = tail_.load(std::memory_order_acquire);
+
+		CallbackStatsScope scope(consumer_->stats_collector(),
+								LoopStatsCollector::kFunctorCallback,
+								reinterpret_cast<intptr_t>(this));
+
+		while (head != cached_tail_) {
+			T *v = At(head);
+			handler_(*v);
+			v->~T();
+			++head;
+
+			// Release each slot as it is done, the producer may be waiting
+			head_.store(head);
+			if (producer_blocked_.load() && producer_blocked_.exchange(false)) {
+				std::shared_ptr<Token> token(token_);
+				producer_->QueueInLoop([token]() {
+					std::lock_guard<std::mutex> lock(token->mutex);
+					LoopChannel *c = token->channel;
+					if (c && c->writable_fn_) {
+						c->writable_fn_();
+					}
+				});
+			}
+		}
+	}
+
+private:
+	EventLoop *producer_;
+	EventLoop *consumer_;
+	MessageHandler handler_;
+	WritableCallback writable_fn_;
+
+	std::unique_ptr<Slot[]> slots_;
+	size_t capacity_;
+	uint64_t mask_;
+
+	std::unique_ptr<EventWatcher> watcher_;
+
+	// Producer side
+	alignas(64) std::atomic<uint64_t> tail_;
+	uint64_t cached_head_;
+
+	// Consumer side
+	alignas(64) std::atomic<uint64_t> head_;
+	uint64_t cached_tail_;
+
+	alignas(64) std::atomic<bool> notified_;
+	std::atomic<bool> producer_blocked_;
+
+	// Held by the functors queued to either loop, the destructor clears
+	// channel
+	struct Token {
+		std::mutex mutex;
+		LoopChannel *channel;
+	};
+	std::shared_ptr<Token> token_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_LOOP_CHANNEL_H */
@@ -0,0 +1,80 @@
+#include "zrtc/event_loop/loop_stats.h"
+
+#include <string.h>
+
+namespace evloop {
+
+#ifdef ZRTC_EVLOOP_STATS
+
+LoopStatsCollector::LoopStatsCollector()
+	: iterations_(0)
+	, loop_us_(0)
+	, callback_us_(0)
+	, max_queue_depth_(0)
+	, callback_depth_(0)
+	, callback_count_(0)
+	, last_scrape_us_(Now())
+	, last_iterations_(0) {
+	for (int i = 0; i < LoopStats::kHistogramBuckets; ++i) {
+		queue_wait_us_[i] = 0;
+		fd_callback_us_[i] = 0;
+		timer_callback_us_[i] = 0;
+	}
+}
+
+void LoopStatsCollector::Add(Histogram &h, int64_t us) {
+	int bucket = 0;
+	while (us > 0 && bucket < LoopStats::kHistogramBuckets - 1) {
+		us >>= 1;
+		++bucket;
+	}
+
+	h[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LoopStatsCollector::Copy(Histogram &h, uint64_t *out) {
+	for (int i = 0; i < LoopStats::kHistogramBuckets; ++i) {
+		out[i] = h[i].load(std::memory_order_relaxed);
+	}
+}
+
+LoopStats LoopStatsCollector::Snapshot() {
+	LoopStats s;
+	s.enabled = true;
+	s.iterations = iterations_.load(std::memory_order_relaxed);
+	s.callback_us = callback_us_.load(std::memory_order_relaxed);
+	s.poll_us = loop_us_.load(std::memory_order_relaxed) - s.callback_us;
+	if (s.poll_us < 0) {
+		// The counters are not read atomically together
+		s.poll_us = 0;
+	}
+	s.max_queue_depth = max_queue_depth_.exchange(0, std::memory_order_relaxed);
+
+	Copy(queue_wait_us_, s.queue_wait_us);
+	Copy(fd_callback_us_, s.fd_callback_us);
+	Copy(timer_callback_us_, s.timer_callback_us);
+
+	std::lock_guard<std::mutex> lock(scrape_mutex_);
+	int64_t now = Now();
+	int64_t elapsed = now - last_scrape_us_;
+	s.iterations_per_sec = elapsed > 0
+			? (s.iterations - last_iterations_) * 1000000.0 / elapsed
+			: 0.0;
+	last_scrape_us_ = now;
+	last_iterations_ = s.iterations;
+
+	return s;
+}
+
+#else
+
+LoopStats LoopStatsCollector::Snapshot() {
+	LoopStats s;
+	memset(&s, 0, sizeof(s));
+	s.enabled = false;
+	return s;
+}
+
+#endif // ZRTC_EVLOOP_STATS
+
+} // namespace evloop
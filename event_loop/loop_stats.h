@@ -0,0 +1,347 @@
+/*
+ * File:   loop_stats.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 2:10 PM
+ */
+
+#ifndef ZRTC_LOOP_STATS_H
+#define ZRTC_LOOP_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include "zrtc/event_loop/event_common.h"
+
+// Build with ZRTC_EVLOOP_STATS to collect the loop metrics. Without it
+// the hooks below are inline no-ops (apart from a plain callback counter)
+// and GetStats() returns a snapshot with enabled == false.
+
+namespace evloop {
+
+// @brief: Snapshot of the health of one EventLoop
+struct LoopStats {
+	// Bucket 0 counts values below 1us, bucket i counts [2^(i-1), 2^i) us,
+	// the last bucket also counts everything above
+	static const int kHistogramBuckets = 24;
+
+	bool enabled;
+
+	uint64_t iterations;       // loop passes since Run()
+	double iterations_per_sec; // since the previous GetStats()
+	int64_t poll_us;           // time blocked in the poller
+	int64_t callback_us;       // time spent in callbacks and functors
+	int max_queue_depth;       // since the previous GetStats()
+
+	uint64_t queue_wait_us[kHistogramBuckets];  // functor enqueue to run
+	uint64_t fd_callback_us[kHistogramBuckets]; // FdChannel::HandleEvent
+	uint64_t timer_callback_us[kHistogramBuckets];
+
+	static int64_t BucketUpperBound(int bucket) {
+		return bucket == 0 ? 1 : (int64_t(1) << bucket);
+	}
+};
+
+// @brief: What the io event thread is running right now, read by a
+// LoopWatchdog from its own thread. Only updated while a watchdog watches
+// the loop, otherwise each callback pays one relaxed load.
+class LoopHeartbeat {
+public:
+	// @brief: One callback, begin_us == 0 while the loop is between
+	// callbacks or blocked in the poller
+	struct Callback {
+		int kind;          // LoopStatsCollector::CallbackKind
+		intptr_t id;       // fd, timer or functor address
+		const void *label; // code address of the callback, may be null
+		int64_t begin_us;
+	};
+
+public:
+	LoopHeartbeat()
+		: enabled_(false)
+		, seq_(0)
+		, iterations_(0)
+		, kind_(0)
+		, id_(0)
+		, label_(nullptr)
+		, begin_us_(0) {
+#ifdef __linux__
+		attached_.store(false, std::memory_order_relaxed);
+#endif
+	}
+
+	bool enabled() const {
+		return enabled_.load(std::memory_order_relaxed);
+	}
+
+	void set_enabled(bool enabled) {
+		enabled_.store(enabled, std::memory_order_relaxed);
+	}
+
+	// @brief: Remember the io event thread, for the stack capture
+	// @note: io event thread only
+	void AttachThread() {
+#ifdef __linux__
+		thread_ = pthread_self();
+		attached_.store(true, std::memory_order_release);
+#endif
+	}
+
+#ifdef __linux__
+	// @return: false if no thread called AttachThread() yet
+	bool thread(pthread_t *t) const {
+		if (!attached_.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		*t = thread_;
+		return true;
+	}
+#endif
+
+	// @note: io event thread only
+	void Beat() {
+		iterations_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	uint64_t iterations() const {
+		return iterations_.load(std::memory_order_relaxed);
+	}
+
+	// @note: io event thread only
+	Callback current() const {
+		Callback c;
+		c.kind = kind_.load(std::memory_order_relaxed);
+		c.id = id_.load(std::memory_order_relaxed);
+		c.label = label_.load(std::memory_order_relaxed);
+		c.begin_us = begin_us_.load(std::memory_order_relaxed);
+		return c;
+	}
+
+	// @note: io event thread only
+	void Set(const Callback &c) {
+		// Seqlock, so that the reader never mixes two callbacks
+		uint32_t seq = seq_.load(std::memory_order_relaxed);
+		seq_.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		kind_.store(c.kind, std::memory_order_relaxed);
+		id_.store(c.id, std::memory_order_relaxed);
+		label_.store(c.label, std::memory_order_relaxed);
+		begin_us_.store(c.begin_us, std::memory_order_relaxed);
+		seq_.store(seq + 2, std::memory_order_release);
+	}
+
+	// @note: It is thread safe
+	Callback Read() const {
+		for (;;) {
+			uint32_t seq = seq_.load(std::memory_order_acquire);
+			if (seq & 1) {
+				continue;
+			}
+
+			Callback c = current();
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (seq_.load(std::memory_order_relaxed) == seq) {
+				return c;
+			}
+		}
+	}
+
+private:
+	std::atomic<bool> enabled_;
+	std::atomic<uint32_t> seq_;
+	std::atomic<uint64_t> iterations_;
+	std::atomic<int> kind_;
+	std::atomic<intptr_t> id_;
+	std::atomic<const void *> label_;
+	std::atomic<int64_t> begin_us_;
+
+#ifdef __linux__
+	std::atomic<bool> attached_;
+	pthread_t thread_;
+#endif
+};
+
+// @brief: Marks a callback in the heartbeat for its lifetime. Nested
+// callbacks show the innermost one, then the outer one again
+class HeartbeatScope {
+public:
+	HeartbeatScope(LoopHeartbeat *h, int kind, intptr_t id,
+				const void *label)
+		: heartbeat_(h)
+		, active_(h->enabled()) {
+		if (active_) {
+			saved_ = h->current();
+
+			LoopHeartbeat::Callback c;
+			c.kind = kind;
+			c.id = id;
+			c.label = label;
+			c.begin_us = MonotonicMicros();
+			h->Set(c);
+		}
+	}
+
+	~HeartbeatScope() {
+		if (active_) {
+			heartbeat_->Set(saved_);
+		}
+	}
+
+private:
+	HeartbeatScope(const HeartbeatScope &);
+	HeartbeatScope &operator=(const HeartbeatScope &);
+
+	LoopHeartbeat *heartbeat_;
+	bool active_;
+	LoopHeartbeat::Callback saved_;
+};
+
+class LoopStatsCollector {
+public:
+	enum CallbackKind {
+		kFdCallback = 0,
+		kTimerCallback = 1,
+		kFunctorCallback = 2,
+	};
+
+#ifdef ZRTC_EVLOOP_STATS
+public:
+	LoopStatsCollector();
+
+	static int64_t Now() {
+		return MonotonicMicros();
+	}
+
+	void AddIteration(int64_t begin_us) {
+		iterations_.fetch_add(1, std::memory_order_relaxed);
+		loop_us_.fetch_add(Now() - begin_us, std::memory_order_relaxed);
+	}
+
+	void AddQueueWait(int64_t wait_us) {
+		Add(queue_wait_us_, wait_us);
+	}
+
+	void AddQueueDepth(int depth) {
+		if (depth > max_queue_depth_.load(std::memory_order_relaxed)) {
+			max_queue_depth_.store(depth, std::memory_order_relaxed);
+		}
+	}
+
+	// Callbacks may nest (StopInLoop drains the queue from inside a
+	// functor), only the outermost one is added to callback_us
+	int64_t BeginCallback() {
+		++callback_count_;
+		++callback_depth_;
+		return Now();
+	}
+
+	void EndCallback(CallbackKind kind, int64_t begin_us) {
+		int64_t elapsed = Now() - begin_us;
+
+		if (kind == kFdCallback) {
+			Add(fd_callback_us_, elapsed);
+		}
+		else if (kind == kTimerCallback) {
+			Add(timer_callback_us_, elapsed);
+		}
+
+		if (--callback_depth_ == 0) {
+			callback_us_.fetch_add(elapsed, std::memory_order_relaxed);
+		}
+	}
+
+	// @note: It is thread safe
+	LoopStats Snapshot();
+
+	// @note: io event thread only
+	uint64_t callback_count() const {
+		return callback_count_;
+	}
+
+	LoopHeartbeat *heartbeat() {
+		return &heartbeat_;
+	}
+
+private:
+	typedef std::atomic<uint64_t> Histogram[LoopStats::kHistogramBuckets];
+
+	static void Add(Histogram &h, int64_t us);
+	static void Copy(Histogram &h, uint64_t *out);
+
+private:
+	std::atomic<uint64_t> iterations_;
+	std::atomic<int64_t> loop_us_;
+	std::atomic<int64_t> callback_us_;
+	std::atomic<int> max_queue_depth_;
+	int callback_depth_;       // io event thread only
+	uint64_t callback_count_;  // io event thread only
+
+	Histogram queue_wait_us_;
+	Histogram fd_callback_us_;
+	Histogram timer_callback_us_;
+
+	std::mutex scrape_mutex_;
+	int64_t last_scrape_us_;     // guard by scrape_mutex_
+	uint64_t last_iterations_;   // guard by scrape_mutex_
+
+	LoopHeartbeat heartbeat_;
+#else
+public:
+	// Only the callback counter and the heartbeat are kept, the busy-poll
+	// mode uses the counter to tell whether a poll found work
+	LoopStatsCollector(): callback_count_(0) {}
+	static int64_t Now() { return 0; }
+	void AddIteration(int64_t) {}
+	void AddQueueWait(int64_t) {}
+	void AddQueueDepth(int) {}
+	int64_t BeginCallback() { ++callback_count_; return 0; }
+	void EndCallback(CallbackKind, int64_t) {}
+	LoopStats Snapshot();
+	uint64_t callback_count() const { return callback_count_; }
+	LoopHeartbeat *heartbeat() { return &heartbeat_; }
+
+private:
+	uint64_t callback_count_;
+	LoopHeartbeat heartbeat_;
+#endif
+};
+
+// @brief: Measures one callback for the loop's LoopStatsCollector and
+// shows it in the heartbeat
+// @param id: fd, timer or functor address reported by a LoopWatchdog
+// @param label: code address of the callback, if known
+class CallbackStatsScope {
+public:
+	CallbackStatsScope(LoopStatsCollector *c,
+					LoopStatsCollector::CallbackKind kind,
+					intptr_t id = 0,
+					const void *label = nullptr)
+		: collector_(c)
+		, kind_(kind)
+		, begin_us_(c->BeginCallback())
+		, heartbeat_(c->heartbeat(), kind, id, label) {
+	}
+
+	~CallbackStatsScope() {
+		collector_->EndCallback(kind_, begin_us_);
+	}
+
+private:
+	CallbackStatsScope(const CallbackStatsScope &);
+	CallbackStatsScope &operator=(const CallbackStatsScope &);
+
+	LoopStatsCollector *collector_;
+	LoopStatsCollector::CallbackKind kind_;
+	int64_t begin_us_;
+	HeartbeatScope heartbeat_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_LOOP_STATS_H */
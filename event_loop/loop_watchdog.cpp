@@ -0,0 +1,355 @@
+#include "zrtc/event_loop/loop_watchdog.h"
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/loop_stats.h"
+
+namespace evloop {
+
+namespace {
+	const char *KindName(int kind) {
+		switch (kind) {
+		case LoopStatsCollector::kFdCallback:
+			return "fd";
+		case LoopStatsCollector::kTimerCallback:
+			return "timer";
+		case LoopStatsCollector::kFunctorCallback:
+			return "functor";
+		default:
+			return "unknown";
+		}
+	}
+
+	std::string Symbolize(const void *address) {
+		if (address == nullptr) {
+			return std::string();
+		}
+
+#ifdef __linux__
+		// Only exported symbols resolve, link with -rdynamic to get them all
+		Dl_info info;
+		if (dladdr(address, &info) != 0 && info.dli_sname != nullptr) {
+			int status = 0;
+			char *name = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+			std::string s = (status == 0 && name != nullptr) ? name : info.dli_sname;
+			free(name);
+			return s;
+		}
+#endif
+
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%p", address);
+		return buf;
+	}
+
+#ifdef __linux__
+	const int kMaxStackDepth = 64;
+
+	// One capture at a time, shared by all the watchdogs. Each capture has
+	// a sequence number: a signal that comes after its capture gave up
+	// finds no request, or one for another thread, and leaves g_stack alone
+	std::mutex g_capture_mutex;
+	uint32_t g_capture_seq = 0;          // guard by g_capture_mutex
+	pthread_t g_capture_thread;
+	std::atomic<uint32_t> g_request(0);  // the capture waiting, 0 if none
+	void *g_stack[kMaxStackDepth];
+	int g_stack_depth = 0;
+	std::atomic<uint32_t> g_stack_seq(0); // the capture g_stack holds
+
+	void CaptureStackHandler(int) {
+		uint32_t seq = g_request.load(std::memory_order_acquire);
+		if (seq == 0 || !pthread_equal(pthread_self(), g_capture_thread)) {
+			return;
+		}
+
+		// Claim it, against the capture giving up meanwhile
+		if (!g_request.compare_exchange_strong(seq, 0)) {
+			return;
+		}
+
+		int saved_errno = errno;
+		g_stack_depth = backtrace(g_stack, kMaxStackDepth);
+		g_stack_seq.store(seq, std::memory_order_release);
+		errno = saved_errno;
+	}
+#endif
+}
+
+std::string StallReport::ToString() const {
+	std::ostringstream os;
+	os << "EventLoop " << loop << " stuck in " << KindName(kind)
+		<< " callback for " << running_us / 1000 << "ms, iteration=" << iteration;
+
+	if (kind == LoopStatsCollector::kFdCallback) {
+		os << ", fd=" << id;
+	}
+	else {
+		os << ", id=" << reinterpret_cast<const void *>(id);
+	}
+
+	if (!label.empty()) {
+		os << ", callback=" << label;
+	}
+
+	for (size_t i = 0; i < stack.size(); ++i) {
+		os << "\n  #" << i << " " << stack[i];
+	}
+
+	return os.str();
+}
+
+LoopWatchdog::LoopWatchdog(int64_t threshold_ms)
+	: threshold_us_(threshold_ms * 1000)
+	, capture_stack_(false)
+	, stack_signal_(kDefaultStackSignal)
+	, stall_count_(0)
+	, quit_(false) {
+}
+
+LoopWatchdog::~LoopWatchdog() {
+	Stop();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (size_t i = 0; i < loops_.size(); ++i) {
+		loops_[i].loop->heartbeat()->set_enabled(false);
+	}
+}
+
+void LoopWatchdog::Watch(EventLoop *loop) {
+	loop->heartbeat()->set_enabled(true);
+
+	Entry e;
+	e.loop = loop;
+	e.reported_id = 0;
+	e.reported_begin_us = 0;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	loops_.push_back(e);
+}
+
+void LoopWatchdog::Unwatch(EventLoop *loop) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (std::this_thread::get_id() != run_tid_) {
+		cond_.wait(lock, [this, loop]() {
+			return std::find(reporting_.begin(), reporting_.end(), loop)
+					== reporting_.end();
+		});
+	}
+
+	for (size_t i = 0; i < loops_.size(); ++i) {
+		if (loops_[i].loop == loop) {
+			loops_.erase(loops_.begin() + i);
+			break;
+		}
+	}
+
+	loop->heartbeat()->set_enabled(false);
+}
+
+void LoopWatchdog::SetCaptureStack(bool enable, int signo) {
+	capture_stack_ = enable;
+	stack_signal_ = signo;
+}
+
+bool LoopWatchdog::Start() {
+	if (thread_.get()) {
+		return false;
+	}
+
+#ifdef __linux__
+	if (capture_stack_) {
+		// The first backtrace() loads libgcc, do it here and not in the
+		// signal handler
+		void *frames[1];
+		backtrace(frames, 1);
+
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = &CaptureStackHandler;
+		sa.sa_flags = SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		if (sigaction(stack_signal_, &sa, nullptr) != 0) {
+			LOG_T_F(LS_WARNING) << "sigaction failed, no stack capture, signo=" << stack_signal_;
+			capture_stack_ = false;
+		}
+	}
+#else
+	capture_stack_ = false;
+#endif
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = false;
+	}
+
+	thread_.reset(new std::thread(std::bind(&LoopWatchdog::Run, this)));
+	return true;
+}
+
+void LoopWatchdog::Stop() {
+	if (!thread_.get()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+
+	cond_.notify_all();
+	thread_->join();
+	thread_.reset();
+}
+
+void LoopWatchdog::Run() {
+	std::chrono::microseconds interval(std::max<int64_t>(threshold_us_ / 4, 1000));
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	run_tid_ = std::this_thread::get_id();
+	std::vector<StallReport> reports;
+	while (!quit_) {
+		cond_.wait_for(lock, interval);
+		if (quit_) {
+			break;
+		}
+
+		int64_t now_us = MonotonicMicros();
+		StallReport r;
+		for (size_t i = 0; i < loops_.size(); ++i) {
+			if (Check(&loops_[i], now_us, &r)) {
+				reports.push_back(r);
+				reporting_.push_back(r.loop);
+			}
+		}
+
+		if (reports.empty()) {
+			continue;
+		}
+
+		// The capture sleeps and the callback may Watch() or Unwatch():
+		// both without the lock. Unwatch() of these loops waits for us
+		lock.unlock();
+		for (size_t i = 0; i < reports.size(); ++i) {
+			if (capture_stack_) {
+				CaptureStack(reports[i].loop, &reports[i].stack);
+			}
+
+			if (report_fn_) {
+				report_fn_(reports[i]);
+			}
+			else {
+				LOG_T_F(LS_WARNING) << reports[i].ToString();
+			}
+		}
+		reports.clear();
+		lock.lock();
+
+		reporting_.clear();
+		cond_.notify_all();
+	}
+
+	run_tid_ = std::thread::id();
+}
+
+bool LoopWatchdog::Check(Entry *e, int64_t now_us, StallReport *r) {
+	LoopHeartbeat::Callback c = e->loop->heartbeat()->Read();
+	if (c.begin_us == 0 || now_us - c.begin_us < threshold_us_) {
+		return false;
+	}
+
+	// Once per stuck callback
+	if (c.begin_us == e->reported_begin_us && c.id == e->reported_id) {
+		return false;
+	}
+
+	e->reported_begin_us = c.begin_us;
+	e->reported_id = c.id;
+	stall_count_.fetch_add(1, std::memory_order_relaxed);
+
+	r->loop = e->loop;
+	r->kind = c.kind;
+	r->id = c.id;
+	r->label = Symbolize(c.label);
+	r->running_us = now_us - c.begin_us;
+	r->iteration = e->loop->heartbeat()->iterations();
+	r->stack.clear();
+	return true;
+}
+
+bool LoopWatchdog::CaptureStack(EventLoop *loop, std::vector<std::string> *stack) {
+#ifdef __linux__
+	pthread_t thread;
+	if (!loop->heartbeat()->thread(&thread) || !loop->IsRunning()) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(g_capture_mutex);
+	uint32_t seq = ++g_capture_seq;
+	if (seq == 0) {
+		seq = ++g_capture_seq;
+	}
+
+	g_capture_thread = thread;
+	g_request.store(seq, std::memory_order_release);
+
+	// The handler runs as soon as the thread is scheduled
+	bool done = false;
+	if (pthread_kill(thread, stack_signal_) == 0) {
+		for (int i = 0; i < 100 && !done; ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			done = g_stack_seq.load(std::memory_order_acquire) == seq;
+		}
+	}
+
+	if (!done) {
+		uint32_t expected = seq;
+		if (g_request.compare_exchange_strong(expected, 0)) {
+			// Withdrawn, a late handler does nothing
+			return false;
+		}
+
+		// The handler has claimed it, let it finish with g_stack
+		while (g_stack_seq.load(std::memory_order_acquire) != seq) {
+			std::this_thread::yield();
+		}
+	}
+
+	int depth = g_stack_depth;
+	if (depth <= 0) {
+		return false;
+	}
+
+	char **symbols = backtrace_symbols(g_stack, depth);
+	if (symbols == nullptr) {
+		return false;
+	}
+
+	// Skip the handler and the signal trampoline
+	for (int i = std::min(depth, 2); i < depth; ++i) {
+		stack->push_back(symbols[i]);
+	}
+
+	free(symbols);
+	return true;
+#else
+	return false;
+#endif
+}
+
+} // namespace evloop
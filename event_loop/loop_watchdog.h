@@ -0,0 +1,122 @@
+/*
+ * File:   loop_watchdog.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 8:10 PM
+ */
+
+#ifndef ZRTC_LOOP_WATCHDOG_H
+#define ZRTC_LOOP_WATCHDOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace evloop {
+
+class EventLoop;
+
+// @brief: A callback that ran longer than the watchdog threshold
+struct StallReport {
+	EventLoop *loop;
+	int kind;               // LoopStatsCollector::CallbackKind
+	intptr_t id;            // the fd of an fd callback, else the timer,
+	                        // channel or functor address
+	std::string label;      // symbol of the callback code, or its address
+	int64_t running_us;     // time in the callback when it was seen
+	uint64_t iteration;     // loop pass it got stuck in
+	std::vector<std::string> stack; // loop thread stack, if captured
+
+	std::string ToString() const;
+};
+
+// @brief: Reports the callbacks that block an io event thread, e.g. a
+// MessageCallback waiting on a lock, which otherwise only shows up as
+// jitter on every connection of the loop. A thread of its own polls the
+// heartbeat of the watched loops, at a quarter of the threshold.
+//
+// Each stuck callback is reported once, from the watchdog thread, by
+// default as a warning log.
+class LoopWatchdog {
+public:
+	typedef std::function<void(const StallReport &)> ReportCallback;
+
+public:
+	explicit LoopWatchdog(int64_t threshold_ms);
+	~LoopWatchdog();
+
+	// @brief: Start watching a loop, before or after Start()
+	// @note: Unwatch it before destroying it. Unwatch() waits for a report
+	// on the loop being made, except from the report callback itself
+	void Watch(EventLoop *loop);
+
+	void Unwatch(EventLoop *loop);
+
+	// @note: Call it before Start()
+	void SetReportCallback(const ReportCallback &cb) {
+		report_fn_ = cb;
+	}
+
+	// @brief: Capture the stack of the stuck loop thread: the watchdog
+	// sends it signo and the handler records a backtrace.
+	// @note: Linux only. Call it before Start(), signo must not be used
+	// by the application nor blocked in the loop threads
+	void SetCaptureStack(bool enable, int signo = kDefaultStackSignal);
+
+	bool Start();
+
+	void Stop();
+
+	// @brief: Number of stalls reported since Start()
+	uint64_t stall_count() const {
+		return stall_count_.load(std::memory_order_relaxed);
+	}
+
+public:
+	// Ignored by default and only raised for sockets with F_SETOWN
+	static const int kDefaultStackSignal = SIGURG;
+
+private:
+	struct Entry {
+		EventLoop *loop;
+		intptr_t reported_id;
+		int64_t reported_begin_us;
+	};
+
+	void Run();
+
+	// @return: true if e is stuck in a callback not reported yet
+	bool Check(Entry *e, int64_t now_us, StallReport *r);
+
+	bool CaptureStack(EventLoop *loop, std::vector<std::string> *stack);
+
+private:
+	int64_t threshold_us_;
+	ReportCallback report_fn_;
+	bool capture_stack_;
+	int stack_signal_;
+	std::atomic<uint64_t> stall_count_;
+
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	bool quit_;                  // guard by mutex_
+	std::vector<Entry> loops_;   // guard by mutex_
+
+	// The loops of the reports being made, with mutex_ released: stack
+	// captures and the report callback. guard by mutex_
+	std::vector<EventLoop *> reporting_;
+	std::thread::id run_tid_;
+
+	std::unique_ptr<std::thread> thread_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_LOOP_WATCHDOG_H */
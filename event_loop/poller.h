@@ -0,0 +1,47 @@
+/*
+ * File:   poller.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 10:10 PM
+ */
+
+#ifndef ZRTC_POLLER_H
+#define ZRTC_POLLER_H
+
+#include <cstdint>
+
+namespace evloop {
+
+class FdChannel;
+
+// @brief: Where an EventLoop built with a native backend keeps its
+// FdChannel registrations instead of one libevent event per fd.
+// See EpollPoller and IoUringPoller
+// @note: io event thread only
+class Poller {
+public:
+	virtual ~Poller() {}
+	
+	virtual bool Init() = 0;
+	
+	// @brief: Register c->fd() or change its interest to flags
+	// (FdChannel::kReadable | kWritable)
+	// @param registered: c is in the set already
+	virtual bool Update(FdChannel *c, int flags, bool edge_triggered,
+						bool registered) = 0;
+	
+	virtual void Remove(FdChannel *c) = 0;
+	
+	// @brief: Hand the queued registration changes to the kernel, the loop
+	// calls it before every poll
+	virtual void Flush() {
+	}
+	
+	// @brief: Registration syscalls since Init()
+	virtual uint64_t ctl_count() const = 0;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_POLLER_H */
+
@@ -0,0 +1,220 @@
+/*
+ * File:   task.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 11:00 AM
+ */
+
+#ifndef ZRTC_TASK_H
+#define ZRTC_TASK_H
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace evloop {
+
+// @brief: Move-only replacement of std::function<void()> for the loop's
+// queue and timer callbacks. Callables up to kInlineSize bytes are stored
+// inside the Task itself, which covers the usual
+// std::bind(&TcpConn::SendInLoop, shared_from_this(), buf) without a heap
+// allocation. Bigger callables, or callables that may throw while moved,
+// fall back to the heap.
+class Task {
+public:
+	static const size_t kInlineSize = 64;
+
+public:
+	Task() noexcept: ops_(nullptr) {}
+
+	Task(std::nullptr_t) noexcept: ops_(nullptr) {}
+
+	template <typename F,
+			typename D = typename std::decay<F>::type,
+			typename = typename std::enable_if<
+				!std::is_same<D, Task>::value>::type>
+	Task(F &&f): ops_(nullptr) {
+		if (IsEmpty(f)) {
+			return;
+		}
+
+		Construct<D>(std::forward<F>(f),
+				std::integral_constant<bool, FitsInline<D>::value>());
+	}
+
+	Task(Task &&other) noexcept: ops_(nullptr) {
+		MoveFrom(other);
+	}
+
+	Task &operator=(Task &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			MoveFrom(other);
+		}
+
+		return *this;
+	}
+
+	Task &operator=(std::nullptr_t) noexcept {
+		Reset();
+		return *this;
+	}
+
+	Task(const Task &) = delete;
+	Task &operator=(const Task &) = delete;
+
+	~Task() {
+		Reset();
+	}
+
+	void operator()() {
+		assert(ops_);
+		ops_->invoke(&storage_);
+	}
+
+	explicit operator bool() const noexcept {
+		return ops_ != nullptr;
+	}
+
+	// @brief: true if the callable lives in the inline storage
+	bool is_inline() const noexcept {
+		return ops_ != nullptr && ops_->is_inline;
+	}
+
+	// @brief: Code address of the invoker generated for the callable type.
+	// Its symbol names the lambda or bound function, for diagnostics
+	const void *invoke_address() const noexcept {
+		return ops_ ? reinterpret_cast<const void *>(ops_->invoke) : nullptr;
+	}
+
+private:
+	typedef typename std::aligned_storage<kInlineSize,
+										alignof(std::max_align_t)>::type Storage;
+
+	struct Ops {
+		void (*invoke)(Storage *s);
+		// Move the callable of src into the uninitialized dst, destroy src
+		void (*relocate)(Storage *dst, Storage *src);
+		void (*destroy)(Storage *s);
+		bool is_inline;
+	};
+
+	template <typename F>
+	struct FitsInline: std::integral_constant<bool,
+			sizeof(F) <= kInlineSize
+			&& alignof(F) <= alignof(std::max_align_t)
+			&& std::is_nothrow_move_constructible<F>::value> {};
+
+	template <typename F>
+	struct InlineOps {
+		static F *Get(Storage *s) {
+			return reinterpret_cast<F *>(s);
+		}
+
+		static void Invoke(Storage *s) {
+			(*Get(s))();
+		}
+
+		static void Relocate(Storage *dst, Storage *src) {
+			::new (static_cast<void *>(dst)) F(std::move(*Get(src)));
+			Get(src)->~F();
+		}
+
+		static void Destroy(Storage *s) {
+			Get(s)->~F();
+		}
+
+		static const Ops ops;
+	};
+
+	template <typename F>
+	struct HeapOps {
+		static F *&Get(Storage *s) {
+			return *reinterpret_cast<F **>(s);
+		}
+
+		static void Invoke(Storage *s) {
+			(*Get(s))();
+		}
+
+		static void Relocate(Storage *dst, Storage *src) {
+			::new (static_cast<void *>(dst)) F *(Get(src));
+			Get(src) = nullptr;
+		}
+
+		static void Destroy(Storage *s) {
+			delete Get(s);
+		}
+
+		static const Ops ops;
+	};
+
+	template <typename D, typename F>
+	void Construct(F &&f, std::true_type /*inline*/) {
+		::new (static_cast<void *>(&storage_)) D(std::forward<F>(f));
+		ops_ = &InlineOps<D>::ops;
+	}
+
+	template <typename D, typename F>
+	void Construct(F &&f, std::false_type /*inline*/) {
+		::new (static_cast<void *>(&storage_)) D *(new D(std::forward<F>(f)));
+		ops_ = &HeapOps<D>::ops;
+	}
+
+	void MoveFrom(Task &other) noexcept {
+		if (other.ops_) {
+			other.ops_->relocate(&storage_, &other.storage_);
+			ops_ = other.ops_;
+			other.ops_ = nullptr;
+		}
+	}
+
+	void Reset() noexcept {
+		if (ops_) {
+			ops_->destroy(&storage_);
+			ops_ = nullptr;
+		}
+	}
+
+	template <typename F>
+	static bool IsEmpty(const F &) {
+		return false;
+	}
+
+	template <typename R, typename... Args>
+	static bool IsEmpty(const std::function<R(Args...)> &f) {
+		return !f;
+	}
+
+	template <typename R, typename... Args>
+	static bool IsEmpty(R (*f)(Args...)) {
+		return f == nullptr;
+	}
+
+private:
+	Storage storage_;
+	const Ops *ops_;
+};
+
+template <typename F>
+const Task::Ops Task::InlineOps<F>::ops = {
+	&Task::InlineOps<F>::Invoke,
+	&Task::InlineOps<F>::Relocate,
+	&Task::InlineOps<F>::Destroy,
+	true,
+};
+
+template <typename F>
+const Task::Ops Task::HeapOps<F>::ops = {
+	&Task::HeapOps<F>::Invoke,
+	&Task::HeapOps<F>::Relocate,
+	&Task::HeapOps<F>::Destroy,
+	false,
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_TASK_H */
@@ -0,0 +1,145 @@
+/*
+ * File:   task_queue.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 9:30 AM
+ */
+
+#ifndef ZRTC_TASK_QUEUE_H
+#define ZRTC_TASK_QUEUE_H
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace evloop {
+
+// @brief: Multi-producer / single-consumer queue guarded by a mutex.
+// Producers append to a shared vector, the consumer swaps it out in one
+// lock and then pops from its private copy without touching the mutex.
+template <typename T>
+class LockedTaskQueue {
+public:
+	LockedTaskQueue(): next_(0) {}
+
+	// @note: It is thread safe
+	void Push(T &&v) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending_.emplace_back(std::move(v));
+	}
+
+	// @note: It must be called in the consumer thread only
+	bool Pop(T *out) {
+		if (next_ == consuming_.size()) {
+			consuming_.clear();
+			next_ = 0;
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			pending_.swap(consuming_);
+		}
+
+		if (next_ == consuming_.size()) {
+			return false;
+		}
+
+		*out = std::move(consuming_[next_]);
+		consuming_[next_] = T();
+		++next_;
+		return true;
+	}
+
+private:
+	std::mutex mutex_;
+	std::vector<T> pending_; // guard by mutex_
+
+	std::vector<T> consuming_;
+	size_t next_;
+};
+
+// @brief: Intrusive lock-free multi-producer / single-consumer queue
+// (D. Vyukov). Push is wait-free: one atomic exchange plus one store.
+// Pop may return false while a producer is between those two steps. The
+// item is then only seen by a later Pop: the producer has to wake the
+// consumer after Push returns, as for any item, rather than the consumer
+// spinning on it.
+template <typename T>
+class MpscTaskQueue {
+public:
+	MpscTaskQueue(): head_(&stub_), tail_(&stub_) {
+		stub_.next.store(nullptr, std::memory_order_relaxed);
+	}
+
+	~MpscTaskQueue() {
+		T v;
+		while (Pop(&v)) {
+		}
+	}
+
+	// @note: It is thread safe
+	void Push(T &&v) {
+		Link(new Node(std::move(v)));
+	}
+
+	// @note: It must be called in the consumer thread only
+	bool Pop(T *out) {
+		Node *tail = tail_;
+		Node *next = tail->next.load(std::memory_order_acquire);
+
+		if (tail == &stub_) {
+			if (next == nullptr) {
+				return false;
+			}
+
+			tail_ = next;
+			tail = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+
+		if (next == nullptr) {
+			if (tail != head_.load(std::memory_order_acquire)) {
+				// A producer is linking a node behind us
+				return false;
+			}
+
+			// tail is the last node, put the stub behind it so that it
+			// can be released
+			stub_.next.store(nullptr, std::memory_order_relaxed);
+			Link(&stub_);
+
+			next = tail->next.load(std::memory_order_acquire);
+			if (next == nullptr) {
+				return false;
+			}
+		}
+
+		*out = std::move(tail->value);
+		tail_ = next;
+		delete tail;
+		return true;
+	}
+
+private:
+	struct Node {
+		Node() {}
+		explicit Node(T &&v): next(nullptr), value(std::move(v)) {}
+
+		std::atomic<Node *> next;
+		T value;
+	};
+
+	void Link(Node *n) {
+		Node *prev = head_.exchange(n, std::memory_order_acq_rel);
+		prev->next.store(n, std::memory_order_release);
+	}
+
+private:
+	// Keep the producer side and the consumer side on different cache lines
+	alignas(64) std::atomic<Node *> head_;
+	alignas(64) Node *tail_;
+	Node stub_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_TASK_QUEUE_H */
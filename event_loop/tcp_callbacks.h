@@ -8,6 +8,7 @@
 #ifndef ZRTC_TCPCALLBACK_H
 #define ZRTC_TCPCALLBACK_H
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 
@@ -27,6 +28,8 @@ typedef std::function<void(const TcpConnPtr &)>
 		WriteReadyCallback;
 typedef std::function<void(const TcpConnPtr &)>
 		CloseCallback;
+typedef std::function<int64_t(const TcpConnPtr &)>
+		OutputPendingCallback;
 typedef std::function<void(const TcpConnPtr &, uint8_t * data, size_t len)> 
 		MessageCallback;
 
@@ -1,4 +1,7 @@
 #include <sys/types.h>
+#include <sys/uio.h>
+
+#include <algorithm>
 
 #include "zrtc/event_loop/tcp_conn.h"
 
@@ -10,11 +13,12 @@
 #include "zrtc/event_loop/event_loop.h"
 #include "zrtc/event_loop/event_sockets.h"
 #include "zrtc/event_loop/invoke_timer.h"
+#include "zrtc/event_loop/keepalive_scheduler.h"
 
 namespace {
 	constexpr size_t kDefaultMaxQueueSize = 200;
 	constexpr size_t kMaxPaketSizeByte = 1500;
-	constexpr int32_t kDefaultPingIntervalMs = 1000;
+	constexpr size_t kMaxWriteBatch = 64; // iovecs per sendmsg
 }
 
 namespace evloop {
@@ -37,9 +41,17 @@ TcpConn::TcpConn(EventLoop* l,
     , status_(kDisconnected)
 	, close_delay_ms_(0)
 	, buffer_(new zrtc::TcpBuffer(kMaxPaketSizeByte))
+	, frame_waiter_(nullptr)
+	, batch_writes_(false)
+	, pending_output_bytes_(0)
 	, enable_ping_(true)
-	, clock_(webrtc::Clock::GetRealTimeClock())
-	, rtt_(0) {
+	, rtt_(0)
+	, keepalive_slot_(-1)
+	, keepalive_index_(0)
+	, last_send_ms_(0)
+	, last_ping_ms_(0) {
+    loop_->IncConnectionCount();
+
     if (sockfd >= 0) {
         chan_.reset(new FdChannel(l, sockfd, false, false));
         chan_->SetReadCallback(std::bind(&TcpConn::HandleRead, this));
@@ -47,15 +59,6 @@ TcpConn::TcpConn(EventLoop* l,
     }
 
     LOG_T_F(LS_INFO) << "TcpConn::[" << name_ << "] channel=" << chan_.get() << " fd=" << sockfd << " addr=" << AddrToString();
-	if (enable_ping_) {
-		auto f = [this]() {
-			assert(loop_->IsInLoopThread());
-			ping_timer_ = loop_->RunEvery(kDefaultPingIntervalMs, std::bind(&TcpConn::Ping, shared_from_this()));
-		};
-		
-		// Queue here because of failure on shared_from_this()
-		loop_->QueueInLoop(f);
-	}
 }
 
 TcpConn::~TcpConn() {
@@ -74,6 +77,7 @@ TcpConn::~TcpConn() {
     }
 
     assert(!delay_close_timer_.get());
+    loop_->DecConnectionCount();
 }
 
 void TcpConn::Close() {
@@ -86,7 +90,18 @@ void TcpConn::Close() {
     };
 
     // Use QueueInLoop to fix TCPClient::Close bug when the application delete TCPClient in callback
-    loop_->QueueInLoop(f);
+    // Urgent: do not wait behind the data sends queued on this loop
+    loop_->QueueInLoop(f, EventLoop::kUrgent);
+}
+
+void TcpConn::ForceClose() {
+    assert(loop_->IsInLoopThread());
+    if (status_ == kDisconnected) {
+        return;
+    }
+
+    status_ = kDisconnecting;
+    HandleClose();
 }
 
 #define lebeswap_64(x)                          \
@@ -155,11 +170,17 @@ void TcpConn::Ping() {
     LOG_T_F(LS_INFO) << "fd=" << fd_ << " status=" << StatusToString() << " addr=" << AddrToString();
 }
 
+TcpConn::PingPacket TcpConn::CreatePingMessage() const {
+	static uint32_t id = 0;
+	int64_t now = loop_->Now();
+	return PingPacket(id++, now);
+}
+
 void TcpConn::Pong() {
     LOG_T_F(LS_INFO) << "fd=" << fd_ << " status=" << StatusToString() << " addr=" << AddrToString();
 	if (buffer_->data_size() >= 16) {
 		PingPacket pong = DeserializePing(buffer_->data());
-		int64_t now = clock_->TimeInMilliseconds();
+		int64_t now = loop_->Now();
 		rtt_ = (now - pong.time);
 		LOG_T_F(LS_INFO) << "rtt=" << rtt_;
 		
@@ -176,7 +197,9 @@ bool TcpConn::Send(const zrtc::TcpBuffer::Ptr &buf) {
 		return false;
 	}
 	LOG_T_F(LS_INFO) << "use_count=" << buf.use_count();
-	loop_->RunInLoop(std::bind(&TcpConn::SendInLoop, shared_from_this(), buf));
+	pending_output_bytes_ += buf->data_size();
+	loop_->RunInLoop(std::bind(&TcpConn::SendInLoop, shared_from_this(), buf),
+					EventLoop::kBulk);
 	
 	return true;
 }
@@ -190,25 +213,145 @@ void TcpConn::SendInLoop(const zrtc::TcpBuffer::Ptr &buf) {
 	
 	LOG_T_F(LS_INFO) << "status=" << StatusToString() << ", chan_=" << chan_->EventsToString();
 	
-	if (status_ == kConnected) {
-		nwritten = ::send(fd_, buf->data(), remaining, MSG_NOSIGNAL);
-		if (write_complete_fn_) {
-			auto n = std::max(nwritten, 0);
-			buf->Skip(n);
-			write_complete_fn_(shared_from_this(), buf);
-			output_bw_stat_.writeStats(n);
-			LOG_T_F(LS_INFO) << "Send out via socket(" << chan_->fd() << "), bytes(" << nwritten << ")";
+	if (batch_writes_ && status_ == kConnected) {
+		// Written together with the other sends of this loop pass
+		if (pending_writes_.empty()) {
+			loop_->RunAtEndOfIteration(std::bind(&TcpConn::FlushWrites,
+												shared_from_this()));
 		}
+		pending_writes_.push_back(buf);
+		return;
+	}
+	
+	pending_output_bytes_ -= remaining;
+	
+	if (status_ != kConnected) {
+		// Closed before the send came up, counted by Stop(timeout_ms)
+		loop_->AddDroppedOutput(remaining);
+		return;
+	}
+	
+	last_send_ms_ = loop_->Now();
+	nwritten = ::send(fd_, buf->data(), remaining, MSG_NOSIGNAL);
+	if (write_complete_fn_) {
+		auto n = std::max(nwritten, 0);
+		buf->Skip(n);
+		write_complete_fn_(shared_from_this(), buf);
+		output_bw_stat_.writeStats(n);
+		LOG_T_F(LS_INFO) << "Send out via socket(" << chan_->fd() << "), bytes(" << nwritten << ")";
+	}
 
-		if (nwritten < 0) {
-			int err = errno;
-			HandleError(err);
-		}
+	if (nwritten < 0) {
+		int err = errno;
+		HandleError(err);
 	}
 	
 	return;
 }
 
+void TcpConn::FlushWrites() {
+	assert(loop_->IsInLoopThread());
+	
+	std::vector<zrtc::TcpBuffer::Ptr> bufs;
+	bufs.swap(pending_writes_);
+	for (size_t k = 0; k < bufs.size(); ++k) {
+		pending_output_bytes_ -= bufs[k]->data_size();
+	}
+	
+	if (!bufs.empty()) {
+		last_send_ms_ = loop_->Now();
+	}
+	
+	size_t i = 0;
+	while (i < bufs.size() && status_ == kConnected) {
+		struct iovec iov[kMaxWriteBatch];
+		size_t n = 0;
+		size_t total = 0;
+		for (; n < kMaxWriteBatch && i + n < bufs.size(); ++n) {
+			iov[n].iov_base = bufs[i + n]->data();
+			iov[n].iov_len = bufs[i + n]->data_size();
+			total += iov[n].iov_len;
+		}
+		
+		// sendmsg rather than writev for MSG_NOSIGNAL
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = n;
+		ssize_t nwritten = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+		int err = errno;
+		
+		size_t remaining = static_cast<size_t>(std::max<ssize_t>(nwritten, 0));
+		output_bw_stat_.writeStats(remaining);
+		LOG_T_F(LS_INFO) << "Send out " << n << " buffers via socket(" << fd_ << "), bytes(" << nwritten << ")";
+		
+		// Report every buffer as SendInLoop does, partially written ones
+		// skipped by what went out
+		for (size_t k = 0; k < n; ++k) {
+			const zrtc::TcpBuffer::Ptr &buf = bufs[i + k];
+			size_t written = std::min(remaining, buf->data_size());
+			remaining -= written;
+			
+			if (write_complete_fn_) {
+				buf->Skip(written);
+				write_complete_fn_(shared_from_this(), buf);
+			}
+		}
+		
+		i += n;
+		
+		if (nwritten < 0 || static_cast<size_t>(nwritten) < total) {
+			// The socket is full or failed: writing the next batch now
+			// could put its bytes on the stream ahead of the unsent tail of
+			// this one, so hand the rest back untouched, in stream order
+			for (; i < bufs.size(); ++i) {
+				if (write_complete_fn_) {
+					write_complete_fn_(shared_from_this(), bufs[i]);
+				}
+			}
+			
+			if (nwritten < 0) {
+				HandleError(err);
+			}
+			return;
+		}
+	}
+	
+	// Closed meanwhile
+	for (; i < bufs.size(); ++i) {
+		loop_->AddDroppedOutput(bufs[i]->data_size());
+	}
+}
+
+void TcpConn::StartDrain(DrainAwaitable *awaitable) {
+	// Send() queues on the kBulk lane and the lanes are FIFO, so this runs
+	// after every send queued before it. With write batching those sends
+	// only reached pending_writes_: the flush is queued at the end of the
+	// pass, and the end of pass functors are FIFO as well
+	TcpConnPtr conn(shared_from_this());
+	loop_->QueueInLoop([conn, awaitable]() {
+		if (conn->pending_writes_.empty()) {
+			awaitable->resumer_();
+			return;
+		}
+		
+		conn->loop_->RunAtEndOfIteration([conn, awaitable]() {
+			awaitable->resumer_();
+		});
+	}, EventLoop::kBulk);
+}
+
+void TcpConn::ResumeFrameWaiter(const uint8_t *data, size_t len) {
+	// The coroutine may drop the last reference to us
+	TcpConnPtr conn(shared_from_this());
+	
+	ReadFrameAwaitable *awaitable = frame_waiter_;
+	frame_waiter_ = nullptr;
+	awaitable->frame_.data = data;
+	awaitable->frame_.len = len;
+	awaitable->resumer_();
+}
+
 void TcpConn::HandleRead() {
     assert(loop_->IsInLoopThread());
 //    if (!buffer_->IsValid()) {
@@ -224,7 +367,11 @@ void TcpConn::HandleRead() {
 				// pong msg
 			Pong();
 		} else if (buffer_->ready()) {
-			msg_fn_(shared_from_this(), buffer_->packet(), buffer_->packet_size());
+			if (frame_waiter_) {
+				ResumeFrameWaiter(buffer_->packet(), buffer_->packet_size());
+			} else if (msg_fn_) {
+				msg_fn_(shared_from_this(), buffer_->packet(), buffer_->packet_size());
+			}
 			buffer_->Rewind();
 		}
     } else if (n == 0) {
@@ -294,10 +441,20 @@ void TcpConn::HandleClose() {
         delay_close_timer_.reset();
     }
 	
-	if (ping_timer_) {
-		LOG_T_F(LS_INFO) << "loop=" << loop_ << ", Cancel the ping timer.";
-		ping_timer_->Cancel();
-		ping_timer_.reset();
+	if (keepalive_slot_ >= 0) {
+		loop_->keepalive_scheduler()->Remove(this);
+	}
+	
+	for (size_t k = 0; k < pending_writes_.size(); ++k) {
+		pending_output_bytes_ -= pending_writes_[k]->data_size();
+		loop_->AddDroppedOutput(pending_writes_[k]->data_size());
+	}
+	pending_writes_.clear();
+	loop_->DetachConnection(this);
+	
+	if (frame_waiter_) {
+		// Resume the reader with an empty frame
+		ResumeFrameWaiter(nullptr, 0);
 	}
 
     if (conn_fn_) {
@@ -329,6 +486,12 @@ void TcpConn::OnAttachedToLoop() {
     assert(loop_->IsInLoopThread());
     status_ = kConnected;
     chan_->EnableReadEvent();
+    loop_->AttachConnection(this);
+
+    if (enable_ping_) {
+        // One timer for all the connections of the loop
+        loop_->keepalive_scheduler()->Add(this);
+    }
 
     if (conn_fn_) {
         conn_fn_(shared_from_this());
@@ -11,20 +11,21 @@
 #include <atomic>
 #include <deque>
 #include <mutex>
+#include <vector>
 
+#include "zrtc/event_loop/awaitable.h"
 #include "zrtc/event_loop/tcp_callbacks.h"
 #include "zrtc/event_loop/event_sockets.h"
 #include "zrtc/network/TcpBuffer.h"
 #include "zrtc/common/Stats.h"
 #include "zrtc/event_loop/invoke_timer.h"
 
-#include "zrtc/webrtc/system_wrappers/include/clock.h"
-
 namespace evloop {
 
 class EventLoop;
 class FdChannel;
 class InvokeTimer;
+class KeepaliveScheduler;
 
 class TcpConn : public std::enable_shared_from_this<TcpConn> {
 public:
@@ -49,6 +50,11 @@ public:
 
     void Close();
 
+    // @brief: Close now, dropping the sends not written yet. Used by
+    // EventLoop::Stop(timeout_ms) once the time is up
+    // @note: It must be called in the io event thread
+    void ForceClose();
+
 	bool Send(const uint8_t *data, size_t len);
 	bool Send(const zrtc::TcpBuffer::Ptr &buf);
 public:
@@ -123,9 +129,124 @@ public:
 		write_ready_fn_ = cb;
 	}
 	
+	// @brief: Hold the sends made in one loop pass and write them with a
+	// single sendmsg at the end of the pass. Off by default. What the
+	// socket did not take goes back through the write complete callback,
+	// one buffer per call in stream order
+	// @note: It must be called in the io event thread
+	void SetWriteBatching(bool on) {
+		batch_writes_ = on;
+	}
+	
+	// @brief: Bytes the application holds back for this connection, e.g.
+	// the unsent buffers the write complete callback handed it, waiting
+	// for the socket to become writable. EventLoop::Stop(timeout_ms)
+	// waits for them to go out as well
+	// @note: It is called in the io event thread
+	void SetOutputPendingCallback(const OutputPendingCallback cb) {
+		output_pending_fn_ = cb;
+	}
+	
+	// @brief: Bytes given to Send() and not handed to the socket yet
+	int64_t pending_output_bytes() const {
+		return pending_output_bytes_.load();
+	}
+	
+	// @brief: pending_output_bytes() and what the application holds back
+	// @note: It must be called in the io event thread
+	int64_t output_backlog_bytes() {
+		int64_t bytes = pending_output_bytes_.load();
+		if (output_pending_fn_) {
+			bytes += output_pending_fn_(shared_from_this());
+		}
+		return bytes;
+	}
+	
 	int32_t GetInputStat() { return input_bw_stat_.getStatsAndReset(); }
 	int32_t GetOutputStat() { return output_bw_stat_.getStatsAndReset(); }
 
+public:
+    // A frame handed to a coroutine. It points into the read buffer and is
+    // valid until the coroutine awaits again
+    struct Frame {
+        Frame() : data(nullptr), len(0) {}
+
+        const uint8_t *data;
+        size_t len;
+
+        // No frame: the connection is closed
+        bool empty() const {
+            return data == nullptr;
+        }
+    };
+
+    class ReadFrameAwaitable {
+    public:
+        explicit ReadFrameAwaitable(TcpConn *c) : conn_(c) {}
+
+        bool await_ready() const {
+            return conn_->IsDisconnected() || conn_->IsDisconnecting();
+        }
+
+        template <typename Handle>
+        void await_suspend(Handle h) {
+            assert(conn_->frame_waiter_ == nullptr);
+            resumer_.Set(h);
+            conn_->frame_waiter_ = this;
+        }
+
+        Frame await_resume() {
+            return frame_;
+        }
+
+    private:
+        friend class TcpConn;
+
+        TcpConn *conn_;
+        Frame frame_;
+        CoroutineResumer resumer_;
+    };
+
+    class DrainAwaitable {
+    public:
+        explicit DrainAwaitable(TcpConn *c) : conn_(c) {}
+
+        bool await_ready() const {
+            return false;
+        }
+
+        template <typename Handle>
+        void await_suspend(Handle h) {
+            resumer_.Set(h);
+            conn_->StartDrain(this);
+        }
+
+        // @return: false if the connection was closed meanwhile
+        bool await_resume() {
+            return conn_->IsConnected();
+        }
+
+    private:
+        friend class TcpConn;
+
+        TcpConn *conn_;
+        CoroutineResumer resumer_;
+    };
+
+    // @brief: co_await conn->ReadFrame() resumes with the next frame, in
+    // place of the MessageCallback. One reader at a time
+    // @note: It must be awaited in the io event thread
+    ReadFrameAwaitable ReadFrame() {
+        return ReadFrameAwaitable(this);
+    }
+
+    // @brief: co_await conn->Drain() resumes once every Send() made before
+    // it has been written to the socket
+    // @note: It must be awaited in the io event thread
+    DrainAwaitable Drain() {
+        return DrainAwaitable(this);
+    }
+
 public:
     // These methods are visible only for TcpClient and TcpServer.
     // We don't want the user layer to access these methods.
@@ -161,6 +282,9 @@ private:
     void DelayClose();
     void HandleError(int err);
 	void SendInLoop(const zrtc::TcpBuffer::Ptr &buf);
+	void FlushWrites();
+	void StartDrain(DrainAwaitable *awaitable);
+	void ResumeFrameWaiter(const uint8_t *data, size_t len);
 
 private:
 //	enum SocketState {
@@ -195,7 +319,13 @@ private:
     MessageCallback msg_fn_; // This will be called to the user application layer
     WriteCompleteCallback write_complete_fn_; // This will be called to the user application layer
 	WriteReadyCallback write_ready_fn_;
+	OutputPendingCallback output_pending_fn_;
     CloseCallback close_fn_; // This will be called to TCPClient or TCPServer
+    ReadFrameAwaitable *frame_waiter_; // The coroutine waiting in ReadFrame()
+
+    bool batch_writes_;
+    std::vector<zrtc::TcpBuffer::Ptr> pending_writes_; // Flushed at the end of the loop pass
+    std::atomic<int64_t> pending_output_bytes_; // Sent but not written yet
 	
 private:
 	struct PingPacket {
@@ -207,20 +337,22 @@ private:
 				, time(time) { }
 	};
 	
+	friend class KeepaliveScheduler;
+	
 	bool enable_ping_;
-	std::shared_ptr<InvokeTimer> ping_timer_;
-	webrtc::Clock *clock_;
 	std::atomic<int64_t> rtt_;
+	
+	// Position in the loop's KeepaliveScheduler, -1 when not registered
+	int keepalive_slot_;
+	size_t keepalive_index_;
+	int64_t last_send_ms_; // Last data handed to the socket, loop clock
+	int64_t last_ping_ms_;
 //	int64_t last_time_sent_ping_;
 	
 	void Ping();
 	void Pong();
 	
-	PingPacket CreatePingMessage() const {
-		static uint32_t id = 0;
-		int64_t now = clock_->TimeInMilliseconds();
-		return PingPacket(id++, now);
-	}
+	PingPacket CreatePingMessage() const;
 	
 	void SerializePing(uint8_t *buffer, PingPacket ping);
 	PingPacket DeserializePing(const uint8_t *buffer);
@@ -0,0 +1,132 @@
+#include "zrtc/event_loop/timer.h"
+
+#include <cstring>
+
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/loop_stats.h"
+
+namespace evloop {
+
+Timer::Timer(EventLoop *loop)
+	: Timer(loop, Callback()) {
+}
+
+Timer::Timer(EventLoop *loop, Callback &&fn)
+	: loop_(loop)
+	, wheel_(loop->timing_wheel())
+	, fn_(std::move(fn))
+	, deadline_ms_(0)
+	, armed_ms_(0) {
+	if (wheel_) {
+		node_.fn = &Timer::WheelHandlerFn;
+		node_.arg = this;
+	}
+	else {
+		memset(&event_, 0, sizeof(struct event));
+		event_set(&event_, -1, 0, &Timer::HandlerFn, this);
+		event_base_set(loop_->event_base(), &event_);
+	}
+}
+
+Timer::~Timer() {
+	Cancel();
+}
+
+void Timer::set_callback(Callback &&fn) {
+	assert(!pending());
+	fn_ = std::move(fn);
+}
+
+void Timer::Start(int64_t delay_ms) {
+	assert(loop_->IsInLoopThread());
+	int64_t deadline = loop_->Now() + (delay_ms > 0 ? delay_ms : 0);
+	deadline_ms_ = deadline;
+	Arm(deadline);
+}
+
+void Timer::Reset(int64_t deadline_ms) {
+	assert(loop_->IsInLoopThread());
+	if (pending() && deadline_ms >= armed_ms_) {
+		// Fire() re-arms for the rest
+		deadline_ms_ = deadline_ms;
+		return;
+	}
+
+	deadline_ms_ = deadline_ms;
+	Arm(deadline_ms);
+}
+
+void Timer::Cancel() {
+	if (!pending()) {
+		return;
+	}
+
+	Disarm();
+	deadline_ms_ = 0;
+}
+
+void Timer::Arm(int64_t deadline_ms) {
+	int64_t delay_ms = deadline_ms - loop_->Now();
+	if (delay_ms < 0) {
+		delay_ms = 0;
+	}
+
+	armed_ms_ = deadline_ms;
+
+	if (wheel_) {
+		wheel_->Add(&node_, delay_ms);
+		return;
+	}
+
+	struct timeval tv;
+	tv.tv_sec = delay_ms / 1000;
+	tv.tv_usec = (delay_ms % 1000) * 1000;
+
+	// event_add moves a pending timer
+	if (EventAdd(&event_, &tv) != 0) {
+		LOG_T_F(LS_ERROR) << "event_add failed. timer=" << this;
+	}
+}
+
+void Timer::Disarm() {
+	if (wheel_) {
+		wheel_->Remove(&node_);
+	}
+	else {
+		EventDel(&event_);
+	}
+
+	armed_ms_ = 0;
+}
+
+void Timer::Fire() {
+	armed_ms_ = 0;
+
+	if (deadline_ms_ > loop_->Now()) {
+		// Pushed back by Reset() meanwhile
+		Arm(deadline_ms_);
+		return;
+	}
+
+	deadline_ms_ = 0;
+	fn_();
+}
+
+void Timer::WheelHandlerFn(void *v) {
+	// The wheel runs it under its own CallbackStatsScope
+	Timer *t = (Timer *)v;
+	t->Fire();
+}
+
+void Timer::HandlerFn(int fd, short which, void *v) {
+	Timer *t = (Timer *)v;
+	CallbackStatsScope scope(t->loop_->stats_collector(),
+							LoopStatsCollector::kTimerCallback,
+							reinterpret_cast<intptr_t>(t),
+							t->fn_.invoke_address());
+	t->Fire();
+}
+
+} // namespace evloop
+
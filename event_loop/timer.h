@@ -0,0 +1,89 @@
+/*
+ * File:   timer.h
+ * Author: lap11894
+ *
+ * Created on October 19, 2026, 12:20 AM
+ */
+
+#ifndef ZRTC_TIMER_H
+#define ZRTC_TIMER_H
+
+#include <cstdint>
+
+#include "zrtc/event_loop/libevent.h"
+#include "zrtc/event_loop/task.h"
+#include "zrtc/event_loop/timing_wheel.h"
+
+namespace evloop {
+
+class EventLoop;
+
+// @brief: A one-shot timer meant to be a member of its owner, e.g. the
+// idle timeout of a connection. Unlike InvokeTimer there is no shared_ptr,
+// no watcher and no RunInLoop: the timer is a TimingWheel node when the
+// loop has a wheel and an embedded struct event otherwise, and arming it
+// allocates nothing.
+//
+// Reset() to a later deadline only stores it while the timer is pending;
+// the timer re-arms itself for the rest when the old deadline comes. So
+// pushing an idle timeout on every packet costs no heap or wheel work.
+// @note: io event thread only. The callback may re-arm the timer but must
+// not destroy it, the destructor cancels a pending timer
+class Timer {
+public:
+	typedef Task Callback;
+
+public:
+	explicit Timer(EventLoop *loop);
+	Timer(EventLoop *loop, Callback &&fn);
+	~Timer();
+
+	// @note: Not while the timer is pending
+	void set_callback(Callback &&fn);
+
+	// @brief: Fire in delay_ms, replacing the pending deadline
+	void Start(int64_t delay_ms);
+
+	// @brief: Fire at deadline_ms on the loop clock (EventLoop::Now()).
+	// An earlier deadline re-arms, a later one is just stored
+	void Reset(int64_t deadline_ms);
+
+	void Cancel();
+
+	bool pending() const {
+		return deadline_ms_ != 0;
+	}
+
+	// @brief: The deadline on the loop clock, 0 when not pending
+	int64_t deadline_ms() const {
+		return deadline_ms_;
+	}
+
+private:
+	Timer(const Timer &);
+	Timer &operator=(const Timer &);
+
+	void Arm(int64_t deadline_ms);
+	void Disarm();
+	void Fire();
+
+	static void WheelHandlerFn(void *v);
+	static void HandlerFn(int fd, short which, void *v);
+
+private:
+	EventLoop *loop_;
+	TimingWheel *wheel_;
+	TimingWheel::Node node_;
+	struct event event_;
+	Callback fn_;
+
+	// What the user asked for, and what the wheel or libevent will wake
+	// us up for: armed_ms_ <= deadline_ms_ while pending
+	int64_t deadline_ms_;
+	int64_t armed_ms_;
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_TIMER_H */
+
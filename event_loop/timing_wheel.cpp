@@ -0,0 +1,310 @@
+#include "zrtc/event_loop/timing_wheel.h"
+
+#include <cstring>
+
+#include "zrtc/event_loop/libevent.h"
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/loop_stats.h"
+
+namespace evloop {
+
+namespace {
+	const uint64_t kRootMask = TimingWheel::kRootSlots - 1;
+	const uint64_t kLevelMask = TimingWheel::kLevelSlots - 1;
+
+	// Ticks covered by the whole wheel
+	const uint64_t kRange = 1ULL << (TimingWheel::kRootBits
+							+ (TimingWheel::kLevels - 1) * TimingWheel::kLevelBits);
+
+	int LevelShift(int level) {
+		return TimingWheel::kRootBits + level * TimingWheel::kLevelBits;
+	}
+
+	void InitHead(TimingWheel::Node *head) {
+		head->prev = head;
+		head->next = head;
+	}
+
+	bool IsEmpty(const TimingWheel::Node *head) {
+		return head->next == head;
+	}
+
+	// Move the whole list of from to the empty head to
+	void Splice(TimingWheel::Node *from, TimingWheel::Node *to) {
+		if (IsEmpty(from)) {
+			InitHead(to);
+			return;
+		}
+
+		to->next = from->next;
+		to->prev = from->prev;
+		to->next->prev = to;
+		to->prev->next = to;
+		InitHead(from);
+	}
+}
+
+TimingWheel::TimingWheel(EventLoop *loop)
+	: loop_(loop)
+	, event_(nullptr)
+	, current_ms_(0)
+	, size_(0)
+	, armed_ms_(0)
+	, advancing_(false) {
+	for (int i = 0; i < kRootSlots; ++i) {
+		InitHead(&root_[i].head);
+	}
+
+	for (int l = 0; l < kLevels - 1; ++l) {
+		for (int i = 0; i < kLevelSlots; ++i) {
+			InitHead(&levels_[l][i].head);
+		}
+	}
+
+	memset(root_bits_, 0, sizeof(root_bits_));
+}
+
+TimingWheel::~TimingWheel() {
+	if (event_) {
+		if (armed_ms_ != 0) {
+			EventDel(event_);
+		}
+
+		delete event_;
+		event_ = nullptr;
+	}
+
+	// The owners of the timers left keep their nodes, just unscheduled
+	Slot *slots[kLevels] = { root_, levels_[0], levels_[1], levels_[2] };
+	for (int l = 0; l < kLevels; ++l) {
+		int count = l == 0 ? kRootSlots : kLevelSlots;
+		for (int i = 0; i < count; ++i) {
+			Node *head = &slots[l][i].head;
+			while (!IsEmpty(head)) {
+				Remove(head->next);
+			}
+		}
+	}
+}
+
+bool TimingWheel::Init() {
+	current_ms_ = loop_->Now();
+
+	event_ = new event();
+	memset(event_, 0, sizeof(struct event));
+	event_set(event_, -1, 0, &TimingWheel::HandlerFn, this);
+	event_base_set(loop_->event_base(), event_);
+	return true;
+}
+
+void TimingWheel::Add(Node *n, int64_t delay_ms) {
+	Remove(n);
+
+	// An empty wheel is not advanced, catch up with the clock. Not from a
+	// callback: Advance() has moved past the slot being expired already,
+	// going back to it would expire the new timer again and again
+	if (size_ == 0 && !advancing_) {
+		current_ms_ = loop_->Now();
+	}
+
+	n->expire_ms = loop_->Now() + (delay_ms > 0 ? delay_ms : 0);
+	Link(n);
+
+	// Rearm() runs once the expired timers are done
+	if (!advancing_ && (armed_ms_ == 0 || n->expire_ms < armed_ms_)) {
+		Rearm();
+	}
+}
+
+void TimingWheel::Remove(Node *n) {
+	if (!n->scheduled()) {
+		return;
+	}
+
+	n->prev->next = n->next;
+	n->next->prev = n->prev;
+	n->prev = nullptr;
+	n->next = nullptr;
+	--size_;
+}
+
+void TimingWheel::Link(Node *n) {
+	Slot *slot = SlotOf(n->expire_ms);
+
+	n->next = &slot->head;
+	n->prev = slot->head.prev;
+	slot->head.prev->next = n;
+	slot->head.prev = n;
+	++size_;
+
+	if (slot >= root_ && slot < root_ + kRootSlots) {
+		int index = (int)(slot - root_);
+		root_bits_[index >> 6] |= 1ULL << (index & 63);
+	}
+}
+
+TimingWheel::Slot *TimingWheel::SlotOf(uint64_t expire_ms) {
+	// Late timers run on the next tick
+	uint64_t expire = expire_ms < current_ms_ ? current_ms_ : expire_ms;
+	uint64_t delta = expire - current_ms_;
+
+	if (delta < (uint64_t)kRootSlots) {
+		return &root_[expire & kRootMask];
+	}
+
+	for (int l = 0; l < kLevels - 1; ++l) {
+		int shift = LevelShift(l);
+		if (delta < (1ULL << (shift + kLevelBits))) {
+			return &levels_[l][(expire >> shift) & kLevelMask];
+		}
+	}
+
+	// Beyond the wheel: park in the farthest slot, Expire() re-inserts it
+	expire = current_ms_ + kRange - 1;
+	return &levels_[kLevels - 2][(expire >> LevelShift(kLevels - 2)) & kLevelMask];
+}
+
+void TimingWheel::Cascade(int level, int index) {
+	Node list;
+	Splice(&levels_[level][index].head, &list);
+
+	while (!IsEmpty(&list)) {
+		Node *n = list.next;
+		Remove(n);
+		Link(n);
+	}
+}
+
+void TimingWheel::Advance(uint64_t now_ms) {
+	if (size_ == 0) {
+		current_ms_ = now_ms;
+		return;
+	}
+
+	while (current_ms_ <= now_ms && size_ > 0) {
+		uint64_t tick = current_ms_;
+		int index = (int)(tick & kRootMask);
+
+		if (index == 0) {
+			// Each upper level moves down when the one below wraps round
+			for (int l = 0; l < kLevels - 1; ++l) {
+				int i = (int)((tick >> LevelShift(l)) & kLevelMask);
+				Cascade(l, i);
+				if (i != 0) {
+					break;
+				}
+			}
+		}
+
+		Slot *slot = &root_[index];
+		if (IsEmpty(&slot->head)) {
+			// Jump to the next occupied slot, or to the next cascade
+			uint64_t next = NextTick();
+			current_ms_ = next < now_ms + 1 ? next : now_ms + 1;
+			continue;
+		}
+
+		// A timer added by a callback with no delay goes to the next tick
+		current_ms_ = tick + 1;
+		Expire(slot);
+	}
+
+	if (size_ == 0) {
+		current_ms_ = now_ms;
+	}
+}
+
+void TimingWheel::Expire(Slot *slot) {
+	uint64_t tick = current_ms_ - 1;
+
+	// The callbacks may add to this slot or remove what is left of it
+	Node list;
+	Splice(&slot->head, &list);
+
+	while (!IsEmpty(&list)) {
+		Node *n = list.next;
+		Remove(n);
+
+		if (n->expire_ms > tick) {
+			// Parked beyond the range of the wheel
+			Link(n);
+			continue;
+		}
+
+		CallbackStatsScope scope(loop_->stats_collector(),
+								LoopStatsCollector::kTimerCallback,
+								reinterpret_cast<intptr_t>(n),
+								reinterpret_cast<const void *>(n->fn));
+		n->fn(n->arg);
+	}
+}
+
+uint64_t TimingWheel::NextTick() {
+	int index = (int)(current_ms_ & kRootMask);
+	uint64_t base = current_ms_ - index;
+
+	for (int w = index >> 6; w < kRootSlots / 64; ++w) {
+		uint64_t bits = root_bits_[w];
+		if (w == index >> 6) {
+			bits &= ~0ULL << (index & 63);
+		}
+
+		while (bits != 0) {
+			int b = w * 64 + __builtin_ctzll(bits);
+			bits &= bits - 1;
+			if (!IsEmpty(&root_[b].head)) {
+				return base + b;
+			}
+
+			root_bits_[w] &= ~(1ULL << (b & 63));
+		}
+	}
+
+	return base + kRootSlots;
+}
+
+void TimingWheel::Rearm() {
+	if (size_ == 0) {
+		if (armed_ms_ != 0) {
+			EventDel(event_);
+			armed_ms_ = 0;
+		}
+
+		return;
+	}
+
+	uint64_t next = NextTick();
+	if (armed_ms_ == next) {
+		return;
+	}
+
+	int64_t now_ms = loop_->Now();
+	int64_t delay_ms = (int64_t)next > now_ms ? (int64_t)next - now_ms : 0;
+
+	struct timeval tv;
+	tv.tv_sec = delay_ms / 1000;
+	tv.tv_usec = (delay_ms % 1000) * 1000;
+
+	// event_add moves a pending timer
+	if (EventAdd(event_, &tv) != 0) {
+		LOG_T_F(LS_ERROR) << "event_add failed for the timing wheel.";
+		armed_ms_ = 0;
+		return;
+	}
+
+	armed_ms_ = next;
+}
+
+void TimingWheel::HandlerFn(int fd, short which, void *v) {
+	TimingWheel *w = (TimingWheel *)v;
+	w->armed_ms_ = 0;
+
+	w->advancing_ = true;
+	w->Advance(w->loop_->Now());
+	w->advancing_ = false;
+
+	w->Rearm();
+}
+
+} // namespace evloop
@@ -0,0 +1,128 @@
+/*
+ * File:   timing_wheel.h
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 11:30 PM
+ */
+
+#ifndef ZRTC_TIMING_WHEEL_H
+#define ZRTC_TIMING_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct event;
+
+namespace evloop {
+
+class EventLoop;
+
+// @brief: Hierarchical timing wheel of one EventLoop, for the many
+// millisecond timers of a busy server (a ping and a close timer per
+// connection). Insert, cancel and expiry are O(1) and allocation free,
+// the timers are intrusive Nodes embedded in their owner.
+//
+// Level 0 has 256 slots of 1ms, the three upper levels 64 slots each of
+// 256ms, 16s and 17.5min, which covers ~18.6h. Longer timers wait in the
+// last level and are re-inserted when it comes round. A single libevent
+// timer wakes the loop at the next occupied level 0 slot or at the next
+// cascade of an upper level, whichever comes first.
+// @note: io event thread only
+class TimingWheel {
+public:
+	typedef void (*Callback)(void *arg);
+
+	// @brief: A timer, embedded in its owner, which must outlive its
+	// scheduling or Remove() it first
+	struct Node {
+		Node *prev;
+		Node *next;
+		uint64_t expire_ms;
+		Callback fn;
+		void *arg;
+
+		Node(): prev(nullptr), next(nullptr), expire_ms(0)
+			, fn(nullptr), arg(nullptr) {
+		}
+
+		bool scheduled() const {
+			return prev != nullptr;
+		}
+	};
+
+	static const int kLevels = 4;
+	static const int kRootBits = 8;
+	static const int kLevelBits = 6;
+	static const int kRootSlots = 1 << kRootBits;
+	static const int kLevelSlots = 1 << kLevelBits;
+
+public:
+	explicit TimingWheel(EventLoop *loop);
+	~TimingWheel();
+
+	bool Init();
+
+	// @brief: Run n->fn(n->arg) in delay_ms, rescheduling n if it was
+	// scheduled already
+	void Add(Node *n, int64_t delay_ms);
+
+	// @brief: Unschedule n, a no-op if it is not scheduled
+	void Remove(Node *n);
+
+	// @brief: Timers scheduled now
+	size_t size() const {
+		return size_;
+	}
+
+	// @brief: Process the ticks up to now_ms and run the expired timers
+	// @note: The loop calls it from the wheel's libevent timer
+	void Advance(uint64_t now_ms);
+
+private:
+	// A list head: an empty slot points to itself
+	struct Slot {
+		Node head;
+	};
+
+	void Link(Node *n);
+	Slot *SlotOf(uint64_t expire_ms);
+
+	// @brief: Move an upper level slot down, one level or straight to the
+	// root
+	void Cascade(int level, int index);
+
+	// @brief: Run the timers of the current root slot
+	void Expire(Slot *slot);
+
+	// @brief: The tick of the next non-empty root slot from current_ms_ on,
+	// or of the next cascade
+	uint64_t NextTick();
+
+	// @brief: Arm the libevent timer for NextTick()
+	void Rearm();
+
+	static void HandlerFn(int fd, short which, void *v);
+
+private:
+	EventLoop *loop_;
+	struct event *event_;
+
+	// The next tick to process
+	uint64_t current_ms_;
+	size_t size_;
+
+	// The libevent timer's deadline, 0 when not armed
+	uint64_t armed_ms_;
+	bool advancing_;
+
+	Slot root_[kRootSlots];
+	Slot levels_[kLevels - 1][kLevelSlots];
+
+	// One bit per non-empty root slot, stale bits are cleared on lookup
+	uint64_t root_bits_[kRootSlots / 64];
+};
+
+} // namespace evloop
+
+#endif /* ZRTC_TIMING_WHEEL_H */
+
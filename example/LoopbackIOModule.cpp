@@ -38,7 +38,8 @@ void LoopbackIOModule::Stop() {
 
 void LoopbackIOModule::Send(const uint8_t* data, uint32_t len) {
 	LoopbackPacketPtr packet = LoopbackPacketPtr(new LoopbackPacket(data, len));
-	loop_.QueueInLoop(std::bind(&LoopbackIOModule::Process, this, std::move(packet)));
+	loop_.QueueInLoop(std::bind(&LoopbackIOModule::Process, this, std::move(packet)),
+					evloop::EventLoop::kBulk);
 }
 
 void LoopbackIOModule::RegisterOnReceiveCallback(OnReceiveCallback cb) {
@@ -131,6 +131,11 @@ public:
 
 	virtual void Send(const uint8_t *data, uint32_t len) override;
 	virtual void RegisterOnReceiveCallback(OnReceiveCallback cb) override;
+	
+	// @note: Call it before Start()
+	void set_cpu_affinity(const evloop::CpuAffinity &affinity) {
+		loop_.SetCpuAffinity(affinity);
+	}
 
 protected:
 	virtual void run() override;
@@ -0,0 +1,125 @@
+/*
+ * File:   TaskQueueBench.cpp
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 9:45 AM
+ */
+
+// Producer throughput and enqueue-to-run latency of the EventLoop pending
+// queues, LockedTaskQueue against MpscTaskQueue, with 1 to 16 producers
+// and one consumer thread that pops and "runs" every item. Give it one
+// core per thread for contention numbers.
+//
+// Not part of any build:
+//   g++ -std=c++11 -O2 -I<dir holding zrtc/> TaskQueueBench.cpp -lpthread
+//   ./a.out [items per producer]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "zrtc/event_loop/task_queue.h"
+
+namespace {
+	int64_t NowNanos() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	struct Item {
+		Item(): enqueue_ns(0) {}
+		explicit Item(int64_t t): enqueue_ns(t) {}
+
+		int64_t enqueue_ns;
+	};
+
+	struct Result {
+		double push_mops;  // pushes per second of all the producers
+		double p50_us;     // enqueue to run
+		double p99_us;
+		double max_us;
+	};
+
+	template <typename Queue>
+	Result Run(int producers, int items) {
+		Queue queue;
+		std::atomic<bool> go(false);
+		std::atomic<int> ready(0);
+		std::vector<int64_t> done_ns(producers, 0);
+
+		std::vector<std::thread> threads;
+		for (int p = 0; p < producers; ++p) {
+			threads.emplace_back([&, p]() {
+				++ready;
+				while (!go.load()) {
+				}
+
+				for (int i = 0; i < items; ++i) {
+					queue.Push(Item(NowNanos()));
+				}
+				done_ns[p] = NowNanos();
+			});
+		}
+
+		size_t total = static_cast<size_t>(producers) * items;
+		std::vector<int64_t> latency;
+		latency.reserve(total);
+
+		while (ready.load() < producers) {
+			std::this_thread::yield();
+		}
+
+		// The consumer is this thread, it spins on Pop as a busy loop would
+		int64_t begin_ns = NowNanos();
+		go = true;
+
+		Item item;
+		while (latency.size() < total) {
+			if (queue.Pop(&item)) {
+				latency.push_back(NowNanos() - item.enqueue_ns);
+			}
+		}
+
+		for (size_t i = 0; i < threads.size(); ++i) {
+			threads[i].join();
+		}
+
+		int64_t push_end_ns = *std::max_element(done_ns.begin(), done_ns.end());
+		std::sort(latency.begin(), latency.end());
+
+		Result r;
+		r.push_mops = total / ((push_end_ns - begin_ns) / 1e3);
+		r.p50_us = latency[total / 2] / 1e3;
+		r.p99_us = latency[total * 99 / 100] / 1e3;
+		r.max_us = latency.back() / 1e3;
+		return r;
+	}
+
+	void Print(const char *name, int producers, const Result &r) {
+		printf("%-8s %9d %12.2f %10.1f %10.1f %10.1f\n",
+			name, producers, r.push_mops, r.p50_us, r.p99_us, r.max_us);
+	}
+}
+
+int main(int argc, char **argv) {
+	int items = argc > 1 ? atoi(argv[1]) : 200000;
+
+	printf("%u hardware threads, %d items per producer\n",
+		std::thread::hardware_concurrency(), items);
+	printf("%-8s %9s %12s %10s %10s %10s\n",
+		"queue", "producers", "push Mops/s", "p50 us", "p99 us", "max us");
+
+	const int kProducers[] = {1, 2, 4, 8, 16};
+	for (size_t i = 0; i < sizeof(kProducers) / sizeof(kProducers[0]); ++i) {
+		int n = kProducers[i];
+		Print("locked", n, Run<evloop::LockedTaskQueue<Item> >(n, items));
+		Print("mpsc", n, Run<evloop::MpscTaskQueue<Item> >(n, items));
+	}
+
+	return 0;
+}
@@ -37,6 +37,25 @@ namespace {
 	constexpr uint32_t kMaxReservedConnections = 3;
 	constexpr uint32_t kDefaultReservedConnectionsCheckMs = 1000;
 	constexpr uint32_t kMaxRttMs = 3000;
+	constexpr int64_t kStopDrainTimeoutMs = 300;
+	constexpr int64_t kStatsTimeoutMs = 100;
+	
+	// Runs f on the io thread for a stats reader. The loop may be stopping
+	// meanwhile and drop f: 0 then, rather than blocking or throwing
+	template <typename F>
+	int32_t ReadStatInLoop(evloop::EventLoop &loop, F &&f) {
+		evloop::Future<int32_t> stat = loop.Submit(std::forward<F>(f),
+												evloop::EventLoop::kUrgent);
+		if (!stat.wait_for(kStatsTimeoutMs)) {
+			return 0;
+		}
+		
+		try {
+			return stat.get();
+		} catch (...) {
+			return 0;
+		}
+	}
 }
 
 TcpIOThread::TcpIOThread()
@@ -46,8 +65,8 @@ TcpIOThread::TcpIOThread()
 	, auto_reconnect_(true)
 	, remote_addr_(kDefaultNetworkAddress)
 //	, local_addr_("")
-	, last_send_time_ms_(-1)
-	, clock_(webrtc::Clock::GetRealTimeClock()){
+	, requeued_(0)
+	, last_send_time_ms_(-1) {
 
 	LOG_T_F(LS_INFO) << "TcpIOThread::TcpIOThread() Create a TCP IO thread...";
 	rtc::LogMessage::LogToDebug(rtc::LoggingSeverity::LS_SENSITIVE);
@@ -108,9 +127,20 @@ void TcpIOThread::Stop() {
 	auto_reconnect_ = false;
 	
 //	LOG_T_F(LS_INFO) << "TcpIOThread::NewConnectionHandler connector's status: %d", connector_->status();
-	Disconnect();
+	// The connection is left open: the drain flushes queue_ through it
+	// and closes it after
+	loop_.QueueInLoop(std::bind(&TcpIOThread::CancelConnectInLoop, this),
+					evloop::EventLoop::kUrgent);
+
+	evloop::Future<evloop::EventLoop::StopResult> stopped = loop_.Stop(kStopDrainTimeoutMs);
+	if (stopped.wait_for(kStopDrainTimeoutMs + 100)) {
+		evloop::EventLoop::StopResult r = stopped.get();
+		LOG_T_F(LS_INFO) << "TcpIOThread::Stop() drained=" << r.drained
+						<< " dropped_tasks=" << r.dropped_tasks
+						<< " dropped_bytes=" << r.dropped_bytes
+						<< " closed_connections=" << r.closed_connections;
+	}
 
-	loop_.Stop();
 	try {
 		thread_.tryJoin(500);
 	} catch (...) {
@@ -136,6 +166,7 @@ bool TcpIOThread::SendData(const uint8_t *data, size_t size) {
 			if (conn_.get()) {
 				LOG_T_F(LS_INFO) << "TcpIOThread::SendData() size(" << size << ")";
 				conn_->Send(data, size);
+				requeued_ = 0;
 				return true;
 			}
 		}
@@ -171,6 +202,7 @@ void TcpIOThread::SendDataInternal() {
 		if (conn_.get()) {
 			conn_->Send(msg);
 			queue_.pop_front();
+			requeued_ = 0;
 		}
 	}
 }
@@ -181,13 +213,19 @@ void TcpIOThread::OnCompleteWrite(const TcpBuffer::Ptr &buf) {
 	// only count fully sent message
 	// ignore ping msg feedback
 	if (!buf || buf->data_size() == 0) {
-		last_send_time_ms_ = clock_->TimeInMilliseconds();
+		last_send_time_ms_ = loop_.Now();
 		return;
 	}
 	
 	{
 		ScopedLock lock(queue_guard_);
-		queue_.push_front(buf);
+		// A batched write hands back its unsent buffers one by one, in
+		// stream order: queue each behind the ones before it
+		if (requeued_ > queue_.size()) {
+			requeued_ = queue_.size();
+		}
+		queue_.insert(queue_.begin() + requeued_, buf);
+		++requeued_;
 		if (conn_.get()) {
 			conn_->EnableWrite();
 		}
@@ -228,6 +266,10 @@ void TcpIOThread::MakeActiveConnection(const evloop::TcpConnPtr& conn) {
 	conn->SetWriteReadyCallback([this](const evloop::TcpConnPtr &conn) {
 		OnReadyWrite();
 	});
+	
+	conn->SetOutputPendingCallback([this](const evloop::TcpConnPtr &conn) -> int64_t {
+		return QueuedBytes(conn);
+	});
 
 	conn->SetCloseCallback([this](const evloop::TcpConnPtr &conn) {
 		conn_.reset();
@@ -265,9 +307,14 @@ void TcpIOThread::OnConnection(int fd, const std::string& local_addr) {
 
 	handler_->OnEstablishConnection(true);
 	
+	// Random phase and jitter: the checks of the io threads started
+	// together do not run in lockstep
+	evloop::PeriodicOptions options;
+	options.phase_ms = evloop::PeriodicOptions::kRandomPhase;
+	options.jitter_ms = kDefaultReservedConnectionsCheckMs / 10;
 	conns_timer_ = loop_.RunEvery(kDefaultReservedConnectionsCheckMs,
-					std::bind(&TcpIOThread::UpdateReservedConnection, this));
-	conns_timer_->Start();
+					std::bind(&TcpIOThread::UpdateReservedConnection, this),
+					options);
 }
 
 void TcpIOThread::OnReservedConnection(int fd, const std::string& local_addr) {
@@ -356,7 +403,8 @@ void TcpIOThread::DoReservedConnect() {
 }
 
 void TcpIOThread::Disconnect() {
-	loop_.QueueInLoop(std::bind(&TcpIOThread::DisconnectInLoop, this));
+	loop_.QueueInLoop(std::bind(&TcpIOThread::DisconnectInLoop, this),
+					evloop::EventLoop::kUrgent);
 }
 
 void TcpIOThread::DisconnectInLoop() {
@@ -379,28 +427,65 @@ void TcpIOThread::DisconnectInLoop() {
 	connector_.reset();
 }
 
+void TcpIOThread::CancelConnectInLoop() {
+	auto_reconnect_ = false;
+	
+	if (!conn_.get() && connector_.get()
+		&& !connector_->IsConnected() && !connector_->IsDisconnected()) {
+		connector_->Cancel();
+	}
+}
+
+int64_t TcpIOThread::QueuedBytes(const evloop::TcpConnPtr &conn) {
+	ScopedLock lock(queue_guard_);
+	if (conn != conn_) {
+		// The reserved connections carry nothing
+		return 0;
+	}
+	
+	int64_t bytes = 0;
+	for (size_t i = 0; i < queue_.size(); ++i) {
+		bytes += queue_[i]->data_size();
+	}
+	return bytes;
+}
+
 int32_t TcpIOThread::InputBwKbit() {
-	if (!conn_.get()) {
+	if (!loop_.IsRunning()) {
 		return 0;
 	}
-	return Utility::bytesToKbit(conn_->GetInputStat());
+	
+	// conn_ is switched by the io thread, read it there
+	return ReadStatInLoop(loop_, [this]() -> int32_t {
+		if (!conn_.get()) {
+			return 0;
+		}
+		return Utility::bytesToKbit(conn_->GetInputStat());
+	});
 }
 
 int32_t TcpIOThread::OutputBwKbit() {
-	if (!conn_.get()) {
+	if (!loop_.IsRunning()) {
 		return 0;
 	}
-	return Utility::bytesToKbit(conn_->GetOutputStat());
+	
+	return ReadStatInLoop(loop_, [this]() -> int32_t {
+		if (!conn_.get()) {
+			return 0;
+		}
+		return Utility::bytesToKbit(conn_->GetOutputStat());
+	});
 }
 
 void TcpIOThread::MaybeUpdateConnection() {
 	LOG_T_F(LS_INFO) << "";
-	int64_t now = clock_->TimeInMilliseconds();
+	int64_t now = loop_.Now();
 	if (!conn_.get()
 	|| conn_->rtt() > kMaxRttMs
 	|| (last_send_time_ms_ != -1
 	&& now - last_send_time_ms_ > kMaxDelaySendTimeMs)) {
-		loop_.QueueInLoop(std::bind(&TcpIOThread::ChangeConnection, this));
+		loop_.QueueInLoop(std::bind(&TcpIOThread::ChangeConnection, this),
+						evloop::EventLoop::kUrgent);
 	}
 }
 
@@ -24,8 +24,6 @@
 #include "zrtc/event_loop/fd_channel.h"
 #include "zrtc/event_loop/tcp_callbacks.h"
 
-#include "zrtc/webrtc/system_wrappers/include/clock.h"
-
 
 BEG_NSP_ZRTC();
 
@@ -55,6 +53,11 @@ public:
 	void set_connect_timeout(uint32_t timeout_ms) {
 		connect_time_out_ms_ = timeout_ms;
 	}
+	
+	// @note: Call it before Start()
+	void set_cpu_affinity(const evloop::CpuAffinity &affinity) {
+		loop_.SetCpuAffinity(affinity);
+	}
 
 protected:
 	virtual void run() override;
@@ -66,6 +69,9 @@ private:
 	void DoReservedConnect();
 	void Disconnect();
 	void DisconnectInLoop();
+	void CancelConnectInLoop();
+	// Bytes of queue_ waiting for conn to become writable
+	int64_t QueuedBytes(const evloop::TcpConnPtr &conn);
 	void MakeActiveConnection(const evloop::TcpConnPtr &conn);
 	
 	void SendDataInternal();
@@ -113,9 +119,11 @@ private:
 	// TODO: wrapper this queue
 	std::mutex queue_guard_;
 	std::deque<TcpBuffer::Ptr> queue_;
+	// Buffers handed back since the last send, at the front of queue_ in
+	// stream order
+	size_t requeued_;
 	
 	int64_t last_send_time_ms_;
-	webrtc::Clock *clock_;
 	
 	std::vector<evloop::TcpConnPtr> conns_vec_;
 	std::shared_ptr<evloop::InvokeTimer> conns_timer_;
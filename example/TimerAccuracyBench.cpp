@@ -0,0 +1,187 @@
+/*
+ * File:   TimerAccuracyBench.cpp
+ * Author: lap11894
+ *
+ * Created on October 18, 2026, 10:40 PM
+ */
+
+// Firing accuracy and jitter of the EventLoop timers under load: another
+// thread queues a 0-300us functor every millisecond while we measure
+//  - the lateness of one-shot timers, on the millisecond (libevent) path,
+//    the microsecond (timerfd) path and a TimerEventWatcher,
+//  - the interval and the drift of 1ms periodic timers on both paths.
+//
+// Not part of any build: link it with the event_loop objects and libevent
+//   g++ -std=c++11 -O2 -I<dir holding zrtc/> TimerAccuracyBench.cpp <event_loop objects> -levent -lpthread
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "zrtc/event_loop/event_common.h"
+#include "zrtc/event_loop/event_loop.h"
+#include "zrtc/event_loop/event_watcher.h"
+
+using evloop::EventLoop;
+using evloop::MonotonicMicros;
+
+namespace {
+	const int kOneShotRuns = 400;
+	const int kPeriods = 2000;
+
+	void Burn(int64_t us) {
+		int64_t begin = MonotonicMicros();
+		while (MonotonicMicros() - begin < us) {
+		}
+	}
+
+	void Report(const char *name, std::vector<int64_t> v) {
+		std::sort(v.begin(), v.end());
+
+		double mean = 0;
+		for (size_t i = 0; i < v.size(); ++i) {
+			mean += v[i];
+		}
+		mean /= v.size();
+
+		double sd = 0;
+		for (size_t i = 0; i < v.size(); ++i) {
+			sd += (v[i] - mean) * (v[i] - mean);
+		}
+		sd = std::sqrt(sd / v.size());
+
+		printf("%-40s n=%zu mean=%.0f sd=%.0f p50=%lld p99=%lld max=%lld us\n",
+			name, v.size(), mean, sd,
+			(long long)v[v.size() / 2],
+			(long long)v[v.size() * 99 / 100],
+			(long long)v.back());
+	}
+
+	enum OneShotKind {
+		kRunAfterMs,
+		kRunAfterMicros,
+		kWatcherMicros,
+	};
+
+	// Lateness of a one-shot timer armed from the loop thread
+	void MeasureOneShot(EventLoop *loop, OneShotKind kind, const char *name) {
+		const int64_t want_us = kind == kRunAfterMs ? 20000 : 2500;
+
+		std::vector<int64_t> late;
+		for (int i = 0; i < kOneShotRuns; ++i) {
+			std::atomic<bool> fired(false);
+			std::atomic<int64_t> late_us(0);
+
+			loop->RunInLoopAndWait([&]() {
+				int64_t begin = MonotonicMicros();
+				auto fn = [&, begin]() {
+					late_us = MonotonicMicros() - begin - want_us;
+					fired = true;
+				};
+
+				if (kind == kRunAfterMs) {
+					loop->RunAfter(static_cast<int>(want_us / 1000), fn);
+				}
+				else if (kind == kRunAfterMicros) {
+					loop->RunAfter(std::chrono::microseconds(want_us), fn);
+				}
+				else {
+					evloop::TimerEventWatcher *w = new evloop::TimerEventWatcher(
+							loop, fn, std::chrono::microseconds(want_us));
+					w->Init();
+					w->AsyncWait();
+					loop->RunAfter(50, [w]() {
+						delete w;
+					});
+				}
+			});
+
+			while (!fired.load()) {
+				usleep(100);
+			}
+			late.push_back(late_us.load());
+		}
+
+		Report(name, late);
+	}
+
+	// Intervals and drift of a 1ms periodic timer
+	void MeasurePeriodic(EventLoop *loop, bool micros, const char *name) {
+		std::vector<int64_t> ticks;
+		ticks.reserve(kPeriods + 1);
+		std::atomic<bool> done(false);
+
+		evloop::InvokeTimerPtr timer;
+		loop->RunInLoopAndWait([&]() {
+			auto fn = [&]() {
+				if (ticks.size() <= static_cast<size_t>(kPeriods)) {
+					ticks.push_back(MonotonicMicros());
+				}
+				else {
+					done = true;
+				}
+			};
+
+			timer = micros ? loop->RunEvery(std::chrono::microseconds(1000), fn)
+						: loop->RunEvery(1, fn);
+		});
+
+		while (!done.load()) {
+			usleep(1000);
+		}
+		loop->RunInLoopAndWait([&timer]() {
+			timer->Cancel();
+		});
+
+		std::vector<int64_t> intervals;
+		for (int i = 1; i <= kPeriods; ++i) {
+			intervals.push_back(ticks[i] - ticks[i - 1]);
+		}
+
+		Report(name, intervals);
+		printf("    drift over %d periods: %lld us\n", kPeriods,
+			(long long)(ticks[kPeriods] - ticks[0] - kPeriods * 1000));
+	}
+}
+
+int main() {
+	EventLoop loop;
+	std::thread io([&loop]() {
+		loop.Run();
+	});
+	while (!loop.IsRunning()) {
+		usleep(1000);
+	}
+
+	std::atomic<bool> stop(false);
+	std::thread load([&]() {
+		std::mt19937 rng(1);
+		while (!stop.load()) {
+			int us = rng() % 300;
+			loop.QueueInLoop([us]() {
+				Burn(us);
+			});
+			usleep(1000);
+		}
+	});
+
+	MeasureOneShot(&loop, kRunAfterMs, "RunAfter(20) libevent, lateness");
+	MeasureOneShot(&loop, kRunAfterMicros, "RunAfter(2500us) timerfd, lateness");
+	MeasureOneShot(&loop, kWatcherMicros, "TimerEventWatcher(2500us), lateness");
+
+	MeasurePeriodic(&loop, false, "RunEvery(1) libevent, interval");
+	MeasurePeriodic(&loop, true, "RunEvery(1000us) timerfd, interval");
+
+	stop = true;
+	load.join();
+	loop.Stop();
+	io.join();
+	return 0;
+}